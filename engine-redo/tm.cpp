@@ -0,0 +1,16 @@
+/**
+ * @file   tm.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction manager built from 'tm_engine.hpp': a redo log, visible
+ * striped records, the ticket batcher of 'src/' and threads sleeping on a
+ * futex while they wait for the next epoch.
+**/
+
+// Internal headers
+#include <tm_engine.hpp>
+
+// -------------------------------------------------------------------------- //
+
+TM_ENGINE_EXPORT(::tm_engine::Engine<::tm_engine::RedoLog, ::tm_engine::Striped<20>, ::tm_engine::TicketBatcher<16>, ::tm_engine::Futex>)
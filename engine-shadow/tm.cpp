@@ -0,0 +1,16 @@
+/**
+ * @file   tm.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction manager built from 'tm_engine.hpp': shadow copies, visible
+ * per-word records, the ticket batcher of 'src/' and threads yielding while
+ * they wait.
+**/
+
+// Internal headers
+#include <tm_engine.hpp>
+
+// -------------------------------------------------------------------------- //
+
+TM_ENGINE_EXPORT(::tm_engine::Engine<::tm_engine::Shadow, ::tm_engine::PerWord, ::tm_engine::TicketBatcher<16>, ::tm_engine::Yield>)
@@ -0,0 +1,16 @@
+/**
+ * @file   tm.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction manager built from 'tm_engine.hpp': an undo log, invisible
+ * reads validated against a global version clock, no admission control and
+ * spinning waits.
+**/
+
+// Internal headers
+#include <tm_engine.hpp>
+
+// -------------------------------------------------------------------------- //
+
+TM_ENGINE_EXPORT(::tm_engine::Engine<::tm_engine::UndoLog, ::tm_engine::InvisibleReads, ::tm_engine::NoAdmission, ::tm_engine::Spin>)
@@ -29,12 +29,14 @@
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <exception>
 #include <mutex>
 #include <thread>
 #include <utility>
 extern "C" {
 #include <time.h>
+#include <unistd.h>
 }
 
 // -------------------------------------------------------------------------- //
@@ -115,6 +117,7 @@ public:
 EXCEPTION(Unreachable, Any, "unreachable code reached");
 EXCEPTION(Bounded, Any, "bounded execution exception");
     EXCEPTION(BoundedOverrun, Any, "bounded execution overrun");
+EXCEPTION(Process, Any, "unable to run a measurement in its own process");
 
 }
 // -------------------------------------------------------------------------- //
@@ -262,6 +265,22 @@ static void short_pause() {
 #endif
 }
 
+/** Get the number of bytes of memory the process currently has resident.
+ * @return Resident bytes (0 if unknown)
+**/
+static size_t resident_bytes() {
+    auto file = ::std::fopen("/proc/self/statm", "r");
+    if (unlikely(!file))
+        return 0;
+    unsigned long size;
+    unsigned long resident;
+    auto res = ::std::fscanf(file, "%lu %lu", &size, &resident);
+    ::std::fclose(file);
+    if (unlikely(res != 2))
+        return 0;
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
 /** Run some function for some bounded time, throws 'Exception::BoundedOverrun' on overtime.
  * @param dur  Maximum execution duration
  * @param func Function to run (void -> void)
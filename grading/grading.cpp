@@ -26,11 +26,16 @@
 #include <atomic>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <variant>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 // Internal headers
 #include "common.hpp"
+#include "scenario.hpp"
 #include "transactional.hpp"
 #include "workload.hpp"
 
@@ -146,12 +151,14 @@ public:
  * @param maxtick_init Timeout for (re)initialization ('Chrono::invalid_tick' for none)
  * @param maxtick_perf Timeout for performance measurements ('Chrono::invalid_tick' for none)
  * @param maxtick_chck Timeout for correctness check ('Chrono::invalid_tick' for none)
- * @return Error constant null-terminated string ('nullptr' for none), execution times (in ns) (undefined if inconsistency detected)
+ * @return Error constant null-terminated string ('nullptr' for none), execution times (in ns) and fraction of the transactions of the performance measurements that aborted (undefined if inconsistency detected)
 **/
 static auto measure(Workload& workload, unsigned int const nbthreads, unsigned int const nbrepeats, Seed seed, Chrono::Tick maxtick_init, Chrono::Tick maxtick_perf, Chrono::Tick maxtick_chck) {
     ::std::vector<::std::thread> threads(nbthreads);
     ::std::mutex  cerrlock;        // To avoid interleaving writes to 'cerr' in case more than one thread throw
     Sync          sync{nbthreads}; // "As-synchronized-as-possible" starts so that threads interfere "as-much-as-possible"
+    ::std::atomic<uint_fast64_t> nbattempts{0}; // Transactions begun during the performance measurements
+    ::std::atomic<uint_fast64_t> nbaborts{0};   // Those of them that aborted
     
     // We start nbthreads threads to measure performance.
     for (unsigned int i = 0; i < nbthreads; ++i) { // Start threads
@@ -163,12 +170,16 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
                 try {
                     // 1. Initialization
                     if (!sync.worker_wait()) return; // Sync. of threads
-                    sync.worker_notify(workload.init()); // Runs the test and tells the master about errors
+                    sync.worker_notify(workload.init(i)); // Runs the test and tells the master about errors
 
                     // 2. Performance measurements
                     for (unsigned int count = 0; count < nbrepeats; ++count) {
                         if (!sync.worker_wait()) return;
-                        sync.worker_notify(workload.run(i, seed + nbthreads * count + i));
+                        auto const stats = transaction_stats; // Counted per thread, so as not to add contention
+                        auto error = workload.run(i, seed + nbthreads * count + i);
+                        nbattempts.fetch_add(transaction_stats.attempts - stats.attempts, ::std::memory_order_relaxed);
+                        nbaborts.fetch_add(transaction_stats.aborts - stats.aborts, ::std::memory_order_relaxed);
+                        sync.worker_notify(error); // Synchronize-with 'master_wait'
                     }
 
                     // 3. Correctness check
@@ -239,7 +250,9 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
             for (unsigned int i = 0; i < nbthreads; ++i)
                 threads[i].join();
         }
-        return ::std::make_tuple(error, time_init, times[posmedian], time_chck);
+        auto attempts = nbattempts.load(::std::memory_order_relaxed);
+        auto abort_rate = attempts > 0 ? static_cast<double>(nbaborts.load(::std::memory_order_relaxed)) / static_cast<double>(attempts) : 0.;
+        return ::std::make_tuple(error, time_init, times[posmedian], time_chck, abort_rate);
     } catch (...) {
         for (unsigned int i = 0; i < nbthreads; ++i) // Detach threads to avoid termination due to attached thread going out of scope
             threads[i].detach();
@@ -257,91 +270,188 @@ static auto measure(Workload& workload, unsigned int const nbthreads, unsigned i
 int main(int argc, char** argv) {
     try {
         // Parse command line option(s)
-        if (argc < 3) {
-            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " <seed> <reference library path> <tested library path>..." << ::std::endl;
+        auto usage = [&]() {
+            ::std::cout << "Usage: " << (argc > 0 ? argv[0] : "grading") << " [--config <scenario file>] [--scenario <name>]... [--set <key>=<value>]... <seed> <reference library path> <tested library path>..." << ::std::endl;
             return 1;
+        };
+        char const* config = nullptr;            // Scenario file, built-in scenarios if none
+        ::std::vector<::std::string> selected;   // Names of the scenarios to run, all if none
+        ::std::vector<::std::string> overrides;  // Parameters set in every scenario
+        auto argi = 1;
+        for (; argi + 1 < argc && ::std::strncmp(argv[argi], "--", 2) == 0; argi += 2) {
+            if (::std::strcmp(argv[argi], "--config") == 0) {
+                config = argv[argi + 1];
+            } else if (::std::strcmp(argv[argi], "--scenario") == 0) {
+                selected.emplace_back(argv[argi + 1]);
+            } else if (::std::strcmp(argv[argi], "--set") == 0) {
+                overrides.emplace_back(argv[argi + 1]);
+            } else {
+                return usage();
+            }
         }
+        if (argc - argi < 2)
+            return usage();
         // Get/set/compute run parameters
-        auto const nbworkers = []() {
+        auto const concurrency = []() {
             auto res = ::std::thread::hardware_concurrency();
             if (unlikely(res == 0))
                 res = 16;
             return static_cast<size_t>(res);
         }();
-        auto const nbtxperwrk    = 200000ul / nbworkers;
-        auto const nbaccounts    = 32 * nbworkers;
-        auto const expnbaccounts = 256 * nbworkers;
-        auto const init_balance  = 100ul;
-        auto const prob_long     = 0.5f;
-        auto const prob_alloc    = 0.01f;
-        auto const nbrepeats     = 7;
-        auto const seed          = static_cast<Seed>(::std::stoul(argv[1]));
-        auto const clk_res       = Chrono::get_resolution();
-        auto const slow_factor   = 16ul;
+        auto scenarios = default_scenarios();
+        if (config) {
+            scenarios.clear();
+            size_t line;
+            auto error = load_scenarios(config, scenarios, line);
+            if (unlikely(error)) {
+                ::std::cout << "⎩ " << config << ":" << line << ": " << error << ::std::endl;
+                return 1;
+            }
+        }
+        if (!selected.empty()) {
+            for (auto const& name: selected) {
+                if (::std::none_of(scenarios.begin(), scenarios.end(), [&](Scenario const& scenario) { return scenario.name == name; })) {
+                    ::std::cout << "⎩ Unknown scenario '" << name << "'" << ::std::endl;
+                    return 1;
+                }
+            }
+            scenarios.erase(::std::remove_if(scenarios.begin(), scenarios.end(), [&](Scenario const& scenario) {
+                return ::std::find(selected.begin(), selected.end(), scenario.name) == selected.end();
+            }), scenarios.end());
+        }
+        for (auto& scenario: scenarios) {
+            for (auto const& assignment: overrides) {
+                auto error = scenario.set(assignment);
+                if (unlikely(error)) {
+                    ::std::cout << "⎩ --set " << assignment << ": " << error << ::std::endl;
+                    return 1;
+                }
+            }
+            auto error = scenario.resolve(concurrency);
+            if (unlikely(error)) {
+                ::std::cout << "⎩ Scenario '" << scenario.name << "': " << error << ::std::endl;
+                return 1;
+            }
+        }
+        auto const seed        = static_cast<Seed>(::std::stoul(argv[argi]));
+        auto const clk_res     = Chrono::get_resolution();
         // Print run parameters
-        ::std::cout << "⎧ #worker threads:     " << nbworkers << ::std::endl;
-        ::std::cout << "⎪ #TX per worker:      " << nbtxperwrk << ::std::endl;
-        ::std::cout << "⎪ #repetitions:        " << nbrepeats << ::std::endl;
-        ::std::cout << "⎪ Initial #accounts:   " << nbaccounts << ::std::endl;
-        ::std::cout << "⎪ Expected #accounts:  " << expnbaccounts << ::std::endl;
-        ::std::cout << "⎪ Initial balance:     " << init_balance << ::std::endl;
-        ::std::cout << "⎪ Long TX probability: " << prob_long << ::std::endl;
-        ::std::cout << "⎪ Allocation TX prob.: " << prob_alloc << ::std::endl;
-        ::std::cout << "⎪ Slow trigger factor: " << slow_factor << ::std::endl;
-        ::std::cout << "⎪ Clock resolution:    ";
+        ::std::cout << "⎧ Clock resolution:    ";
         if (unlikely(clk_res == Chrono::invalid_tick)) {
             ::std::cout << "<unknown>" << ::std::endl;
         } else {
             ::std::cout << clk_res << " ns" << ::std::endl;
         }
         ::std::cout << "⎩ Seed value:          " << seed << ::std::endl;
-        // Library evaluations
-        double reference = 0.; // Set to avoid irrelevant '-Wmaybe-uninitialized'
-        auto const pertxdiv = static_cast<double>(nbworkers) * static_cast<double>(nbtxperwrk);
-        auto maxtick_init = Chrono::invalid_tick;
-        auto maxtick_perf = Chrono::invalid_tick;
-        auto maxtick_chck = Chrono::invalid_tick;
-        for (auto i = 2; i < argc; ++i) {
-            ::std::cout << "⎧ Evaluating '" << argv[i] << "'" << (maxtick_init == Chrono::invalid_tick ? " (reference)" : "") << "..." << ::std::endl;
-            // Load TM library
-            TransactionalLibrary tl{argv[i]};
-            // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
-            WorkloadBank bank{tl, nbworkers, nbtxperwrk, nbaccounts, expnbaccounts, init_balance, prob_long, prob_alloc};
-            try {
-                // Actual performance measurements and correctness check
-                auto res = measure(bank, nbworkers, nbrepeats, seed, maxtick_init, maxtick_perf, maxtick_chck);
-                // Check false negative-free correctness
-                auto error = ::std::get<0>(res);
-                if (unlikely(error)) {
-                    ::std::cout << "⎩ " << error << ::std::endl;
-                    return 1;
-                }
-                // Print results
-                auto tick_init = ::std::get<1>(res);
-                auto tick_perf = ::std::get<2>(res);
-                auto tick_chck = ::std::get<3>(res);
-                auto perfdbl = static_cast<double>(tick_perf);
-                ::std::cout << "⎪ Total user execution time: " << (perfdbl / 1000000.) << " ms";
-                if (maxtick_init == Chrono::invalid_tick) { // Set reference performance
-                    maxtick_init = slow_factor * tick_init;
-                    if (unlikely(maxtick_init == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_init;
-                    maxtick_perf = slow_factor * tick_perf;
-                    if (unlikely(maxtick_perf == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_perf;
-                    maxtick_chck = slow_factor * tick_chck;
-                    if (unlikely(maxtick_chck == Chrono::invalid_tick)) // Bad luck...
-                        ++maxtick_chck;
-                    reference = perfdbl;
-                } else { // Compare with reference performance
-                    ::std::cout << " -> " << (reference / perfdbl) << " speedup";
+        for (auto const& scenario: scenarios) {
+            ::std::cout << "⎧ Scenario '" << scenario.name << "'" << ::std::endl;
+            ::std::cout << "⎪ Workload:            " << (scenario.large ? "large-scale bank" : "bank") << ::std::endl;
+            ::std::cout << "⎪ #worker threads:     " << scenario.nbworkers << ::std::endl;
+            ::std::cout << "⎪ #TX per worker:      " << scenario.nbtxperwrk << ::std::endl;
+            ::std::cout << "⎪ #repetitions:        " << scenario.nbrepeats << ::std::endl;
+            ::std::cout << "⎪ Slow trigger factor: " << scenario.slow_factor << ::std::endl;
+            ::std::cout << "⎪ Initial #accounts:   " << scenario.nbaccounts << ::std::endl;
+            ::std::cout << "⎪ Expected #accounts:  " << scenario.expnbaccounts << ::std::endl;
+            if (scenario.large)
+                ::std::cout << "⎪ #accounts/segment:   " << scenario.nbpersegment << ::std::endl;
+            ::std::cout << "⎪ Initial balance:     " << scenario.init_balance << ::std::endl;
+            ::std::cout << "⎪ Long TX probability: " << scenario.prob_long << ::std::endl;
+            ::std::cout << "⎪ Allocation TX prob.: " << scenario.prob_alloc << ::std::endl;
+            ::std::cout << "⎪ Zipf exponent:       " << scenario.skew_zipf << ::std::endl;
+            ::std::cout << "⎩ Hot accounts:        " << scenario.skew_hot << ::std::endl;
+        }
+        // Library evaluations, against the reference performance of each scenario
+        struct Bounds {
+            double       reference = 0.;                    // Reference execution time
+            Chrono::Tick maxtick_init = Chrono::invalid_tick; // Timeout for (re)initialization ('Chrono::invalid_tick' for none)
+            Chrono::Tick maxtick_perf = Chrono::invalid_tick; // Timeout for performance measurements
+            Chrono::Tick maxtick_chck = Chrono::invalid_tick; // Timeout for correctness check
+        };
+        ::std::vector<Bounds> bounds(scenarios.size());
+        auto const slowed = [&](Scenario const& scenario, Chrono::Tick tick) { // Timeout after the given reference time
+            auto res = scenario.slow_factor * tick;
+            if (unlikely(res == Chrono::invalid_tick)) // Bad luck...
+                ++res;
+            return res;
+        };
+        for (auto i = argi + 1; i < argc; ++i) {
+            auto const is_reference = i == argi + 1;
+            ::std::cout << "⎧ Evaluating '" << argv[i] << "'" << (is_reference ? " (reference)" : "") << "..." << ::std::endl;
+            for (size_t k = 0; k < scenarios.size(); ++k) {
+                auto const& scenario = scenarios[k];
+                auto& bound = bounds[k];
+                // Each measurement in a fresh process, so that the memory kept resident by the ones before does not count
+                int channel[2]; // Bounds set by the reference, from the child
+                if (unlikely(::pipe(channel) != 0))
+                    throw Exception::Process{};
+                auto child = ::fork();
+                if (unlikely(child < 0))
+                    throw Exception::Process{};
+                if (child == 0) {
+                    ::close(channel[0]);
+                    // Load TM library
+                    TransactionalLibrary tl{argv[i]};
+                    auto const resident_base = resident_bytes(); // To report the memory the library keeps resident for the workload
+                    // Initialize workload (shared memory lifetime bound to workload: created and destroyed at the same time)
+                    ::std::unique_ptr<Workload> workload;
+                    if (scenario.large) {
+                        workload = ::std::make_unique<WorkloadBankLarge>(tl, scenario.nbworkers, scenario.nbtxperwrk, scenario.nbaccounts, scenario.expnbaccounts, scenario.nbpersegment, scenario.init_balance, scenario.prob_long, scenario.prob_alloc, scenario.skew_zipf, scenario.skew_hot);
+                    } else {
+                        workload = ::std::make_unique<WorkloadBank>(tl, scenario.nbworkers, scenario.nbtxperwrk, scenario.nbaccounts, scenario.expnbaccounts, scenario.init_balance, scenario.prob_long, scenario.prob_alloc, scenario.skew_zipf, scenario.skew_hot);
+                    }
+                    auto const last = k + 1 == scenarios.size();
+                    ::std::cout << (last ? "⎩ " : "⎪ ") << "Scenario '" << scenario.name << "':" << ::std::endl;
+                    auto const prefix = last ? "  " : "⎪ ";
+                    try {
+                        // Actual performance measurements and correctness check
+                        auto res = measure(*workload, scenario.nbworkers, scenario.nbrepeats, seed, bound.maxtick_init, bound.maxtick_perf, bound.maxtick_chck);
+                        // Check false negative-free correctness
+                        auto error = ::std::get<0>(res);
+                        if (unlikely(error)) {
+                            ::std::cout << prefix << "⎩ " << error << ::std::endl;
+                            ::std::exit(1);
+                        }
+                        // Print results
+                        auto tick_init = ::std::get<1>(res);
+                        auto tick_perf = ::std::get<2>(res);
+                        auto tick_chck = ::std::get<3>(res);
+                        auto perfdbl = static_cast<double>(tick_perf);
+                        auto pertxdiv = static_cast<double>(scenario.nbworkers) * static_cast<double>(scenario.nbtxperwrk);
+                        auto resident = resident_bytes();
+                        resident = resident > resident_base ? resident - resident_base : 0;
+                        ::std::cout << prefix << "⎧ Total user execution time: " << (perfdbl / 1000000.) << " ms";
+                        if (is_reference) { // Set reference performance
+                            bound.maxtick_init = slowed(scenario, tick_init);
+                            bound.maxtick_perf = slowed(scenario, tick_perf);
+                            bound.maxtick_chck = slowed(scenario, tick_chck);
+                            bound.reference = perfdbl;
+                            if (unlikely(::write(channel[1], &bound, sizeof(bound)) != sizeof(bound)))
+                                throw Exception::Process{};
+                        } else { // Compare with reference performance
+                            ::std::cout << " -> " << (bound.reference / perfdbl) << " speedup";
+                        }
+                        ::std::cout << ::std::endl;
+                        ::std::cout << prefix << "⎪ Average TX execution time: " << (perfdbl / pertxdiv) << " ns" << ::std::endl;
+                        ::std::cout << prefix << "⎪ Throughput:                " << (pertxdiv * 1000. / perfdbl) << " MTX/s" << ::std::endl;
+                        ::std::cout << prefix << "⎪ Abort rate:                " << (::std::get<4>(res) * 100.) << " %" << ::std::endl;
+                        ::std::cout << prefix << "⎩ Resident memory growth:    " << (static_cast<double>(resident) / 1048576.) << " MiB" << ::std::endl;
+                    } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
+                        ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
+                        ::std::cerr << "⎩ " << err.what() << ::std::endl;
+                        ::std::quick_exit(2);
+                    }
+                    ::std::exit(0);
                 }
-                ::std::cout << ::std::endl;
-                ::std::cout << "⎩ Average TX execution time: " << (perfdbl / pertxdiv) << " ns" << ::std::endl;
-            } catch (::std::exception const& err) { // Special case: cannot unload library with running threads, so print error and quick-exit
-                ::std::cerr << "⎪ *** EXCEPTION ***" << ::std::endl;
-                ::std::cerr << "⎩ " << err.what() << ::std::endl;
-                ::std::quick_exit(2);
+                ::close(channel[1]);
+                auto received = is_reference ? ::read(channel[0], &bound, sizeof(bound)) : 0;
+                ::close(channel[0]);
+                int status;
+                if (unlikely(::waitpid(child, &status, 0) != child))
+                    throw Exception::Process{};
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) // Failure already reported by the child
+                    return WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+                if (unlikely(is_reference && received != sizeof(bound)))
+                    throw Exception::Process{};
             }
         }
         return 0;
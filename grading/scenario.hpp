@@ -0,0 +1,227 @@
+/**
+ * @file   scenario.hpp
+ *
+ * @section DESCRIPTION
+ *
+ * Named workload scenarios, built-in or read from a configuration file made of
+ * sections of 'key = value' lines:
+ *
+ *     # Comment
+ *     threads = 8          # Before any section: default of every scenario
+ *     [read-heavy]
+ *     prob_long = 0.9
+ *
+ * The keys are those of 'Scenario::set'.
+**/
+
+#pragma once
+
+// External headers
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include "common.hpp"
+#include "transactional.hpp"
+#include "workload.hpp"
+
+// -------------------------------------------------------------------------- //
+
+/** Parameters of one scenario of the bank workload, or of its large-scale variant.
+**/
+class Scenario final {
+public:
+    using Balance = WorkloadBank::Balance;
+public:
+    ::std::string name;           // Name in the results
+    bool         large;           // Whether to run the large-scale variant ('WorkloadBankLarge')
+    size_t       nbworkers;       // Number of concurrent threads, 0 for the hardware concurrency
+    size_t       nbtx;            // Total number of TX per repetition, shared among the workers
+    size_t       nbtxperwrk;      // Number of TX per worker, 0 for 'nbtx' split among the workers
+    size_t       nbaccounts;      // Initial number of accounts, 0 for 32 per worker
+    size_t       expnbaccounts;   // Expected total number of accounts, 0 for 256 per worker
+    Balance      init_balance;    // Initial account balance
+    float        prob_long;       // Probability of running a long, read-only control transaction
+    float        prob_alloc;      // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+    float        skew_zipf;       // Zipf exponent of the choice of accounts, 0 for uniform
+    float        skew_hot;        // Fraction of hot accounts, 0 for none
+    size_t       nbpersegment;    // Number of accounts per segment of the large-scale variant
+    unsigned int nbrepeats;       // Number of repetitions (keep the median)
+    unsigned int slow_factor;     // Timeout, as a factor of the reference times, 0 for the default of the workload
+public:
+    /** Default scenario constructor.
+     * @param name Name in the results
+    **/
+    explicit Scenario(::std::string name): name{::std::move(name)}, large{false}, nbworkers{0}, nbtx{200000}, nbtxperwrk{0}, nbaccounts{0}, expnbaccounts{0}, init_balance{100}, prob_long{0.5f}, prob_alloc{0.01f}, skew_zipf{0.f}, skew_hot{0.f}, nbpersegment{4096}, nbrepeats{7}, slow_factor{0} {}
+private:
+    /** Parse a whole non-negative number.
+     * @param text   Text to parse
+     * @param target Parsed number
+     * @return Whether the whole text is a number
+    **/
+    template<class Number> static bool parse(::std::string const& text, Number& target) {
+        char* end;
+        errno = 0;
+        if constexpr (::std::is_floating_point_v<Number>) {
+            target = static_cast<Number>(::std::strtod(text.c_str(), &end));
+        } else {
+            if (text.empty() || text[0] == '-')
+                return false;
+            target = static_cast<Number>(::std::strtoull(text.c_str(), &end, 10));
+        }
+        return !text.empty() && *end == '\0' && errno == 0;
+    }
+public:
+    /** Set one parameter.
+     * @param key   Parameter name
+     * @param value Textual value
+     * @return Constant null-terminated error message, 'nullptr' for none
+    **/
+    char const* set(::std::string const& key, ::std::string const& value) {
+        if (key == "workload") {
+            if (value == "bank") {
+                large = false;
+            } else if (value == "large-bank") {
+                large = true;
+            } else {
+                return "'workload' expects 'bank' or 'large-bank'";
+            }
+        } else if (key == "threads") {
+            if (!parse(value, nbworkers))
+                return "'threads' expects a number of threads (0 for the hardware concurrency)";
+        } else if (key == "tx") {
+            if (!parse(value, nbtx))
+                return "'tx' expects a number of transactions";
+        } else if (key == "tx_per_worker") {
+            if (!parse(value, nbtxperwrk))
+                return "'tx_per_worker' expects a number of transactions (0 for 'tx' split among the workers)";
+        } else if (key == "accounts") {
+            if (!parse(value, nbaccounts))
+                return "'accounts' expects a number of accounts (0 for 32 per worker)";
+        } else if (key == "expected_accounts") {
+            if (!parse(value, expnbaccounts))
+                return "'expected_accounts' expects a number of accounts (0 for 256 per worker)";
+        } else if (key == "init_balance") {
+            if (!parse(value, init_balance) || init_balance <= 0)
+                return "'init_balance' expects a positive balance";
+        } else if (key == "prob_long") {
+            if (!parse(value, prob_long) || !(prob_long >= 0.f && prob_long <= 1.f))
+                return "'prob_long' expects a probability";
+        } else if (key == "prob_alloc") {
+            if (!parse(value, prob_alloc) || !(prob_alloc >= 0.f && prob_alloc <= 1.f))
+                return "'prob_alloc' expects a probability";
+        } else if (key == "zipf") {
+            if (!parse(value, skew_zipf) || !(skew_zipf >= 0.f))
+                return "'zipf' expects a non-negative exponent";
+        } else if (key == "hot") {
+            if (!parse(value, skew_hot) || !(skew_hot >= 0.f && skew_hot < 1.f))
+                return "'hot' expects a fraction in [0, 1)";
+        } else if (key == "segment_accounts") {
+            if (!parse(value, nbpersegment) || nbpersegment == 0)
+                return "'segment_accounts' expects a positive number of accounts";
+        } else if (key == "repeats") {
+            if (!parse(value, nbrepeats) || nbrepeats == 0)
+                return "'repeats' expects a positive number of repetitions";
+        } else if (key == "slow_factor") {
+            if (!parse(value, slow_factor))
+                return "'slow_factor' expects a factor of the reference times (0 for the default of the workload)";
+        } else {
+            return "unknown key (expected workload, threads, tx, tx_per_worker, accounts, expected_accounts, init_balance, prob_long, prob_alloc, zipf, hot, segment_accounts, repeats or slow_factor)";
+        }
+        return nullptr;
+    }
+    /** Set one parameter from a 'key=value' string.
+     * @param assignment Assignment to parse
+     * @return Constant null-terminated error message, 'nullptr' for none
+    **/
+    char const* set(::std::string const& assignment) {
+        auto pos = assignment.find('=');
+        if (pos == ::std::string::npos)
+            return "expected 'key=value'";
+        return set(trim(assignment.substr(0, pos)), trim(assignment.substr(pos + 1)));
+    }
+    /** Replace the parameters tied to the number of threads by their defaults.
+     * @param concurrency Hardware concurrency
+     * @return Constant null-terminated error message, 'nullptr' for none
+    **/
+    char const* resolve(size_t concurrency) {
+        if (nbworkers == 0)
+            nbworkers = concurrency;
+        if (nbtxperwrk == 0)
+            nbtxperwrk = nbtx / nbworkers;
+        if (nbaccounts == 0)
+            nbaccounts = 32 * nbworkers;
+        if (expnbaccounts == 0)
+            expnbaccounts = 256 * nbworkers;
+        if (slow_factor == 0) // The reference copies whole segments under its lock, where a TM instruments every word
+            slow_factor = large ? 64 : 16;
+        if (unlikely(nbaccounts < 2))
+            return "at least 2 accounts are required";
+        return nullptr;
+    }
+    /** Remove the leading and trailing blanks of a string.
+     * @param text String to trim
+     * @return Trimmed string
+    **/
+    static ::std::string trim(::std::string const& text) {
+        auto first = text.find_first_not_of(" \t\r");
+        if (first == ::std::string::npos)
+            return {};
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+};
+
+/** Built-in scenarios: the uniform bank workload only, other mixes being read from a configuration file.
+ * @return Scenarios
+**/
+static auto default_scenarios() {
+    ::std::vector<Scenario> scenarios;
+    scenarios.emplace_back("uniform");
+    return scenarios;
+}
+
+/** Read scenarios from a configuration file.
+ * @param path      Path of the file
+ * @param scenarios Scenarios read, in the order of the file
+ * @param line      Number of the faulty line, on error
+ * @return Constant null-terminated error message, 'nullptr' for none
+**/
+static char const* load_scenarios(char const* path, ::std::vector<Scenario>& scenarios, size_t& line) {
+    ::std::ifstream file{path};
+    line = 0;
+    if (!file)
+        return "unable to open the scenario file";
+    Scenario defaults{""}; // Set by the lines before the first section
+    ::std::string text;
+    while (::std::getline(file, text)) {
+        ++line;
+        text = Scenario::trim(text.substr(0, text.find('#')));
+        if (text.empty())
+            continue;
+        if (text.front() == '[') { // New scenario
+            if (text.back() != ']')
+                return "expected '[name]'";
+            auto name = Scenario::trim(text.substr(1, text.size() - 2));
+            if (name.empty())
+                return "empty scenario name";
+            for (auto const& scenario: scenarios) {
+                if (scenario.name == name)
+                    return "duplicate scenario name";
+            }
+            scenarios.push_back(defaults);
+            scenarios.back().name = ::std::move(name);
+            continue;
+        }
+        auto error = (scenarios.empty() ? defaults : scenarios.back()).set(text);
+        if (error)
+            return error;
+    }
+    if (scenarios.empty())
+        return "no scenario defined";
+    return nullptr;
+}
@@ -602,6 +602,14 @@ public:
 
 // -------------------------------------------------------------------------- //
 
+/** Per-thread counters of the transactions run through 'transactional'.
+**/
+struct TransactionStats final {
+    uint_fast64_t attempts = 0; // Number of transactions begun
+    uint_fast64_t aborts   = 0; // Number of those that aborted and were retried
+};
+static thread_local TransactionStats transaction_stats;
+
 /** Repeat a given transaction until it commits.
  * @param tm   Transactional memory
  * @param mode Transactional mode
@@ -611,9 +619,11 @@ public:
 template<class Func> static auto transactional(TransactionalMemory const& tm, Transaction::Mode mode, Func&& func) {
     do {
         try {
+            ++transaction_stats.attempts;
             Transaction tx{tm, mode};
             return func(tx);
         } catch (Exception::TransactionRetry const&) {
+            ++transaction_stats.aborts;
             continue;
         }
     } while (true);
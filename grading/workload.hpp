@@ -24,8 +24,11 @@
 #pragma once
 
 // External headers
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <random>
+#include <vector>
 
 // Internal headers
 #include "common.hpp"
@@ -40,6 +43,85 @@ using Uid = uint_fast32_t;
 **/
 using Seed = uint_fast32_t;
 
+/** Zipf distribution over [0, n), index k being drawn with a probability proportional to 1 / (k + 1)^s.
+ * Rejection-inversion sampling (Hörmann and Derflinger), in constant time whatever n, so that the
+ * distribution can be rebuilt cheaply whenever n changes. An exponent of 0 falls back to the uniform one.
+**/
+class ZipfDistribution final {
+private:
+    size_t n;         // Number of values
+    double s;         // Exponent
+    double hx1;       // Integral of 'h' up to 1.5, minus 1
+    double hn;        // Integral of 'h' up to n + 0.5
+    double threshold; // Acceptance threshold without evaluating the integral
+private:
+    double h(double x) const noexcept {
+        return ::std::exp(-s * ::std::log(x));
+    }
+    static double helper1(double x) noexcept { // log1p(x) / x, accurate near 0
+        return ::std::abs(x) > 1e-8 ? ::std::log1p(x) / x : 1. - x * (1. / 2. - x * (1. / 3. - x / 4.));
+    }
+    static double helper2(double x) noexcept { // expm1(x) / x, accurate near 0
+        return ::std::abs(x) > 1e-8 ? ::std::expm1(x) / x : 1. + x / 2. * (1. + x / 3. * (1. + x / 4.));
+    }
+    double hintegral(double x) const noexcept {
+        auto logx = ::std::log(x);
+        return helper2((1. - s) * logx) * logx;
+    }
+    double hinverse(double x) const noexcept {
+        auto t = ::std::max(x * (1. - s), -1.);
+        return ::std::exp(helper1(t) * x);
+    }
+public:
+    /** Distribution constructor.
+     * @param n Number of values (positive)
+     * @param s Exponent (non-negative)
+    **/
+    ZipfDistribution(size_t n, double s): n{n}, s{s}, hx1{hintegral(1.5) - 1.}, hn{hintegral(static_cast<double>(n) + 0.5)}, threshold{2. - hinverse(hintegral(2.5) - h(2.))} {}
+    /** Draw one value.
+     * @param engine Randomness source
+     * @return Value in [0, n)
+    **/
+    template<class Engine> size_t operator()(Engine& engine) const {
+        if (s <= 0.)
+            return ::std::uniform_int_distribution<size_t>{0, n - 1}(engine);
+        ::std::uniform_real_distribution<double> unit{0., 1.};
+        while (true) {
+            auto u = hn + unit(engine) * (hx1 - hn);
+            auto x = hinverse(u);
+            auto k = ::std::clamp(static_cast<double>(static_cast<size_t>(x + 0.5)), 1., static_cast<double>(n));
+            if (k - x <= threshold || u >= hintegral(k + 0.5) - h(k))
+                return static_cast<size_t>(k) - 1;
+        }
+    }
+};
+
+/** Distribution of the accounts taking part in short transactions.
+**/
+class AccountDistribution final {
+private:
+    size_t nbhot;                       // Number of hot accounts, all of them if no hot set
+    ::std::bernoulli_distribution cold; // Whether to pick a cold account
+    ZipfDistribution hot_dist;          // Choice among the hot accounts
+    ZipfDistribution cold_dist;         // Choice among the cold accounts
+public:
+    /** Distribution constructor.
+     * @param count Number of accounts
+     * @param zipf  Zipf exponent, 0 for uniform
+     * @param hot   Fraction of hot accounts, 0 for none
+    **/
+    AccountDistribution(size_t count, float zipf, float hot): nbhot{hot > 0.f && hot < 1.f && count > 1 ? ::std::clamp<size_t>(static_cast<size_t>(hot * count), 1, count - 1) : count}, cold{nbhot < count ? hot : 0.}, hot_dist{nbhot, zipf}, cold_dist{::std::max<size_t>(count - nbhot, 1), zipf} {}
+    /** Draw one account.
+     * @param engine Randomness source
+     * @return Account index
+    **/
+    template<class Engine> size_t operator()(Engine& engine) {
+        if (cold.p() > 0. && cold(engine)) // Uniform choices draw nothing more from the engine
+            return nbhot + cold_dist(engine);
+        return hot_dist(engine);
+    }
+};
+
 /** Workload base class.
 **/
 class Workload {
@@ -60,11 +142,81 @@ public:
     /** Virtual destructor.
     **/
     virtual ~Workload() {};
+protected:
+    /**
+     * Test in which we check that multiple concurrent transactions can decrease a counter in a sequential manner.
+     * @param uid       Id of the thread to run the check
+     * @param nbworkers Total number of concurrent threads running the check
+     * @param barrier   Barrier synchronizing these threads
+     * @return Constant null-terminated error message, 'nullptr' for none
+    **/
+    char const* check_counter(Uid uid, size_t nbworkers, Barrier const& barrier) const {
+        constexpr size_t nbtxperwrk = 100;
+
+        barrier.sync();
+        if (uid == 0) { // Only the first thread initializes the shared memory.
+            // We first write the initial value,
+            auto init_counter = nbtxperwrk * nbworkers;
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                counter = init_counter;
+            });
+
+            // And check in another transaction that it was written correctly.
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                return counter == init_counter;
+            });
+            if (unlikely(!correct)) {
+                barrier.sync();
+                barrier.sync();
+                return "Violated consistency during initialization";
+            }
+        }
+
+        // In each thread,
+        barrier.sync();
+        for (size_t i = 0; i < nbtxperwrk; ++i) {
+
+            // We first fetch the last value of the counter,
+            auto last = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                return counter.read();
+            });
+
+            // And then we decrease the value of the counter after checking that it didn't increase since the last read.
+            auto correct = transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                auto value = counter.read();
+                if (unlikely(value > last))
+                    return false;
+                counter = value - 1;
+                return true;
+            });
+            if (unlikely(!correct)) {
+                barrier.sync();
+                return "Violated consistency, isolation or atomicity";
+            }
+        }
+
+        // Finally, a last transaction runs in the first thread to check that the counter reached 0 (i.e., each transaction decreased it by 1.).
+        barrier.sync();
+        if (uid == 0) {
+            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+                Shared<size_t> counter{tx, tm.get_start()};
+                return counter == 0;
+            });
+            if (unlikely(!correct))
+                return "Violated consistency";
+        }
+        return nullptr;
+    }
 public:
-    /** Shared memory (re)initialization.
+    /** [thread-safe] Worker's share of the shared memory (re)initialization.
+     * @param Unique ID (between 0 to n-1)
      * @return Constant null-terminated error message, 'nullptr' for none
     **/
-    virtual char const* init() const = 0;
+    virtual char const* init(Uid) const = 0;
     /** [thread-safe] Worker's full run.
      * @param Unique ID (between 0 to n-1)
      * @param Seed to use
@@ -140,6 +292,8 @@ private:
     Balance init_balance;  // Initial account balance
     float   prob_long;     // Probability of running a long, read-only control transaction
     float   prob_alloc;    // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+    float   skew_zipf;     // Zipf exponent of the choice of accounts, 0 for uniform
+    float   skew_hot;      // Fraction of hot accounts, which draw all but that fraction of the accesses, 0 for none
     Barrier barrier;       // Barrier for thread synchronization during 'check'
 public:
     /** Bank workload constructor.
@@ -151,8 +305,10 @@ public:
      * @param init_balance  Initial account balance
      * @param prob_long     Probability of running a long, read-only control transaction
      * @param prob_alloc    Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+     * @param skew_zipf     Zipf exponent of the choice of accounts, 0 for uniform
+     * @param skew_hot      Fraction of hot accounts, which draw all but that fraction of the accesses, 0 for none
     **/
-    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc): Workload{library, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, barrier{nbworkers} {}
+    WorkloadBank(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, Balance init_balance, float prob_long, float prob_alloc, float skew_zipf = 0.f, float skew_hot = 0.f): Workload{library, AccountSegment::align(), AccountSegment::size(nbaccounts)}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, skew_zipf{skew_zipf}, skew_hot{skew_hot}, barrier{nbworkers} {}
 private:
     /** Long read-only transaction, summing the balance of each account.
      * @param count Loosely-updated number of accounts
@@ -277,7 +433,7 @@ public:
     /**
      * Initialize the first segment of accounts and check the initial ballance (2 transactions).
     **/
-    virtual char const* init() const {
+    virtual char const* init(Uid uid [[gnu::unused]]) const {
         transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
             AccountSegment segment{tx, tm.get_start()};
             segment.count = nbaccounts;
@@ -303,6 +459,8 @@ public:
         ::std::bernoulli_distribution alloc_dist{prob_alloc};
         ::std::gamma_distribution<float> alloc_trigger(expnbaccounts, 1);
         size_t count = nbaccounts;
+        size_t account_count = count; // Number of accounts 'account' was built for
+        AccountDistribution account{count, skew_zipf, skew_hot};
         for (size_t cntr = 0; cntr < nbtxperwrk; ++cntr) {
             if (long_dist(engine)) { // We roll a dice and, if "lucky", run a long transaction.
                 if (unlikely(!long_tx(count))) // If it fails, then we return an error message.
@@ -310,7 +468,10 @@ public:
             } else if (alloc_dist(engine)) { // Let's roll a dice again to trigger an allocation transaction.
                 alloc_tx(alloc_trigger(engine));
             } else { // No luck with previous rolls, let's just run a short transaction.
-                ::std::uniform_int_distribution<size_t> account{0, count - 1};
+                if (account_count != count) { // Long transactions update the number of accounts
+                    account = AccountDistribution{count, skew_zipf, skew_hot};
+                    account_count = count;
+                }
                 while (unlikely(!short_tx(account(engine), account(engine))));
             }
         }
@@ -326,64 +487,247 @@ public:
      * @param uid Id of the thread to run the check
     **/
     virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
-        constexpr size_t nbtxperwrk = 100;
+        return check_counter(uid, nbworkers, barrier);
+    }
+};
 
-        barrier.sync();
-        if (uid == 0) { // Only the first thread initializes the shared memory.
-            // We first write the initial value,
-            auto init_counter = nbtxperwrk * nbworkers;
+// -------------------------------------------------------------------------- //
+
+/** Large-scale bank workload class: same transactions and invariants as 'WorkloadBank', but with accounts
+ * in fixed-size segments indexed by a transactional directory, so that finding an account takes 2 reads
+ * whatever the number of accounts, and with the initialization partitioned among the workers.
+**/
+class WorkloadBankLarge final: public Workload {
+public:
+    /** Account balance class alias.
+    **/
+    using Balance = WorkloadBank::Balance;
+private:
+    /** Shared directory of the segments of accounts, in the first segment of the region.
+    **/
+    class Directory final {
+    private:
+        /** Dummy structure for size and alignment retrieval.
+        **/
+        struct Dummy {
+            size_t   dummy0;
+            Balance  dummy1;
+            Balance* dummy2[];
+        };
+    public:
+        /** Get the directory size for a given number of segments.
+         * @param nbsegments Maximum number of segments
+         * @return Directory size (in bytes)
+        **/
+        constexpr static auto size(size_t nbsegments) noexcept {
+            return sizeof(Dummy) + nbsegments * sizeof(Balance*);
+        }
+        /** Get the directory alignment.
+         * @return Directory alignment (in bytes)
+        **/
+        constexpr static auto align() noexcept {
+            return alignof(Dummy);
+        }
+    public:
+        Shared<size_t>        count; // Total number of allocated accounts, account i being at index i % per segment of segment i / per segment
+        Shared<Balance>      parity; // Balance correction for when deleting an account
+        Shared<Balance*[]> segments; // Segments of accounts (null if not allocated, 'Shared<T*>::free' writing null back)
+    public:
+        /** Deleted copy constructor/assignment.
+        **/
+        Directory(Directory const&) = delete;
+        Directory& operator=(Directory const&) = delete;
+        /** Binding constructor.
+         * @param tx      Associated pending transaction
+         * @param address Block base address
+        **/
+        Directory(Transaction& tx, void* address): count{tx, address}, parity{tx, count.after()}, segments{tx, parity.after()} {}
+    };
+private:
+    size_t  nbworkers;     // Number of concurrent workers
+    size_t  nbtxperwrk;    // Number of transactions per worker
+    size_t  nbaccounts;    // Initial number of accounts
+    size_t  expnbaccounts; // Expected total number of accounts
+    size_t  nbpersegment;  // Number of accounts per segment
+    size_t  nbsegments;    // Capacity of the directory, in segments
+    Balance init_balance;  // Initial account balance
+    float   prob_long;     // Probability of running a long, read-only control transaction
+    float   prob_alloc;    // Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+    float   skew_zipf;     // Zipf exponent of the choice of accounts, 0 for uniform
+    float   skew_hot;      // Fraction of hot accounts, which draw all but that fraction of the accesses, 0 for none
+    Barrier barrier;       // Barrier for thread synchronization during 'init' and 'check'
+private:
+    /** Get the capacity of the directory, leaving room for the accounts to grow up to twice the initial or expected number.
+     * @param nbaccounts    Initial number of accounts
+     * @param expnbaccounts Expected total number of accounts
+     * @param nbpersegment  Number of accounts per segment
+     * @return Number of segments
+    **/
+    constexpr static size_t capacity(size_t nbaccounts, size_t expnbaccounts, size_t nbpersegment) noexcept {
+        return (2 * ::std::max(nbaccounts, expnbaccounts) + nbpersegment - 1) / nbpersegment + 1;
+    }
+public:
+    /** Large-scale bank workload constructor.
+     * @param library       Transactional library to use
+     * @param nbworkers     Total number of concurrent threads (for 'init', 'run' and 'check')
+     * @param nbtxperwrk    Number of transactions per worker
+     * @param nbaccounts    Initial number of accounts
+     * @param expnbaccounts Expected total number of accounts
+     * @param nbpersegment  Number of accounts per segment
+     * @param init_balance  Initial account balance
+     * @param prob_long     Probability of running a long, read-only control transaction
+     * @param prob_alloc    Probability of running an allocation/deallocation transaction, knowing a long transaction won't run
+     * @param skew_zipf     Zipf exponent of the choice of accounts, 0 for uniform
+     * @param skew_hot      Fraction of hot accounts, which draw all but that fraction of the accesses, 0 for none
+    **/
+    WorkloadBankLarge(TransactionalLibrary const& library, size_t nbworkers, size_t nbtxperwrk, size_t nbaccounts, size_t expnbaccounts, size_t nbpersegment, Balance init_balance, float prob_long, float prob_alloc, float skew_zipf = 0.f, float skew_hot = 0.f): Workload{library, Directory::align(), Directory::size(capacity(nbaccounts, expnbaccounts, nbpersegment))}, nbworkers{nbworkers}, nbtxperwrk{nbtxperwrk}, nbaccounts{nbaccounts}, expnbaccounts{expnbaccounts}, nbpersegment{nbpersegment}, nbsegments{capacity(nbaccounts, expnbaccounts, nbpersegment)}, init_balance{init_balance}, prob_long{prob_long}, prob_alloc{prob_alloc}, skew_zipf{skew_zipf}, skew_hot{skew_hot}, barrier{nbworkers} {}
+private:
+    /** Long read-only transaction, summing the balance of each account, one segment per read.
+     * @param count  Loosely-updated number of accounts
+     * @param buffer Private buffer of (at least) one segment of accounts
+     * @return Whether no inconsistency has been found
+    **/
+    bool long_tx(size_t& nbaccounts, ::std::vector<Balance>& buffer) const {
+        return transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            Directory directory{tx, tm.get_start()};
+            size_t count = directory.count;
+            auto sum = directory.parity.read(); // Total balance on all accounts + parity amount.
+            for (size_t first = 0; first < count; first += nbpersegment) {
+                auto length = ::std::min(nbpersegment, count - first);
+                tx.read(directory.segments[first / nbpersegment].read(), length * sizeof(Balance), buffer.data());
+                for (size_t i = 0; i < length; ++i) {
+                    if (unlikely(buffer[i] < 0)) // If one account has a negative balance, there's a consistency issue.
+                        return false;
+                    sum += buffer[i];
+                }
+            }
+            nbaccounts = count;
+            return sum == static_cast<Balance>(init_balance * count); // Consistency check: no money should ever be destroyed or created out of thin air.
+        });
+    }
+    /** Account (de)allocation transaction, adding accounts with initial balance or removing them.
+     * @param trigger Trigger level that will decide whether to allocate or deallocate
+    **/
+    void alloc_tx(size_t trigger) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            Directory directory{tx, tm.get_start()};
+            size_t count = directory.count;
+            if (count > trigger && likely(count > 2)) { // If there are "too many" accounts, we remove the last one.
+                --count;
+                auto segment = directory.segments[count / nbpersegment];
+                Shared<Balance> account{tx, segment.read() + count % nbpersegment};
+                directory.parity = directory.parity.read() + account.read() - init_balance; // We remove 1x the initial balance but don't break parity.
+                directory.count = count;
+                if (count % nbpersegment == 0) // If there's no one in the last segment anymore, we deallocate it.
+                    segment.free();
+            } else if (count / nbpersegment < nbsegments) { // Otherwise we add one, unless the directory is full.
+                auto segment = directory.segments[count / nbpersegment];
+                Balance* accounts = (count % nbpersegment == 0 ? segment.alloc(nbpersegment * sizeof(Balance)) : segment.read());
+                Shared<Balance> account{tx, accounts + count % nbpersegment};
+                account = init_balance;
+                directory.count = count + 1;
+            }
+        });
+    }
+    /** Short read-write transaction, transferring one unit from an account to an account (potentially the same).
+     * @param send_id Index of the sender account
+     * @param recv_id Index of the receiver account (potentially same as source)
+     * @return Whether the parameters were satisfying and the transaction committed on useful work
+    **/
+    bool short_tx(size_t send_id, size_t recv_id) const {
+        return transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+            Directory directory{tx, tm.get_start()};
+            size_t count = directory.count;
+            if (send_id >= count || recv_id >= count)
+                return false; // At least one account does not exist => do nothing
+            Shared<Balance> sender{tx, directory.segments[send_id / nbpersegment].read() + send_id % nbpersegment};
+            Shared<Balance> recver{tx, directory.segments[recv_id / nbpersegment].read() + recv_id % nbpersegment};
+            auto send_val = sender.read();
+            if (send_val > 0) {
+                sender = send_val - 1;
+                recver = recver.read() + 1;
+            }
+            return true;
+        });
+    }
+public:
+    /**
+     * Allocate and fill the segments of accounts, worker 'uid' taking every 'nbworkers'-th one in its own transaction
+     * (1 transaction per segment), then check the initial balance once all are done (1 transaction).
+     * @param uid Id of the worker
+    **/
+    virtual char const* init(Uid uid) const {
+        ::std::vector<Balance> accounts(nbpersegment, init_balance);
+        if (uid == 0) {
             transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                counter = init_counter;
+                Directory directory{tx, tm.get_start()};
+                directory.count  = nbaccounts;
+                directory.parity = 0;
             });
-
-            // And check in another transaction that it was written correctly.
-            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                return counter == init_counter;
+        }
+        for (size_t first = uid * nbpersegment; first < nbaccounts; first += nbworkers * nbpersegment) {
+            transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
+                Directory directory{tx, tm.get_start()};
+                auto segment = directory.segments[first / nbpersegment];
+                tx.write(accounts.data(), ::std::min(nbpersegment, nbaccounts - first) * sizeof(Balance), segment.alloc(nbpersegment * sizeof(Balance)));
             });
-            if (unlikely(!correct)) {
-                barrier.sync();
-                barrier.sync();
-                return "Violated consistency during initialization";
-            }
         }
-
-        // In each thread,
         barrier.sync();
-        for (size_t i = 0; i < nbtxperwrk; ++i) {
-
-            // We first fetch the last value of the counter,
-            auto last = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                return counter.read();
-            });
+        if (uid != 0)
+            return nullptr;
+        auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
+            Directory directory{tx, tm.get_start()};
+            if (directory.count != nbaccounts)
+                return false;
+            auto last = nbaccounts - 1;
+            Shared<Balance> first_account{tx, directory.segments[0].read()};
+            Shared<Balance> last_account{tx, directory.segments[last / nbpersegment].read() + last % nbpersegment};
+            return first_account == init_balance && last_account == init_balance;
+        });
+        if (unlikely(!correct))
+            return "Violated consistency (check that committed writes in shared memory get visible to the following transactions' reads)";
+        return nullptr;
+    }
 
-            // And then we decrease the value of the counter after checking that it didn't increase since the last read.
-            auto correct = transactional(tm, Transaction::Mode::read_write, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                auto value = counter.read();
-                if (unlikely(value > last))
-                    return false;
-                counter = value - 1;
-                return true;
-            });
-            if (unlikely(!correct)) {
-                barrier.sync();
-                return "Violated consistency, isolation or atomicity";
+    /**
+     * Run nbtxperwrk random transactions until completion.
+     * @param seed Randomness source
+    **/
+    virtual char const* run(Uid uid [[gnu::unused]], Seed seed) const {
+        ::std::minstd_rand engine{seed};
+        ::std::bernoulli_distribution long_dist{prob_long};
+        ::std::bernoulli_distribution alloc_dist{prob_alloc};
+        ::std::gamma_distribution<float> alloc_trigger(expnbaccounts, 1);
+        ::std::vector<Balance> buffer(nbpersegment);
+        size_t count = nbaccounts;
+        size_t account_count = count; // Number of accounts 'account' was built for
+        AccountDistribution account{count, skew_zipf, skew_hot};
+        for (size_t cntr = 0; cntr < nbtxperwrk; ++cntr) {
+            if (long_dist(engine)) { // We roll a dice and, if "lucky", run a long transaction.
+                if (unlikely(!long_tx(count, buffer))) // If it fails, then we return an error message.
+                    return "Violated isolation or atomicity";
+            } else if (alloc_dist(engine)) { // Let's roll a dice again to trigger an allocation transaction.
+                alloc_tx(alloc_trigger(engine));
+            } else { // No luck with previous rolls, let's just run a short transaction.
+                if (account_count != count) { // Long transactions update the number of accounts
+                    account = AccountDistribution{count, skew_zipf, skew_hot};
+                    account_count = count;
+                }
+                while (unlikely(!short_tx(account(engine), account(engine))));
             }
         }
-
-        // Finally, a last transaction runs in the first thread to check that the counter reached 0 (i.e., each transaction decreased it by 1.).
-        barrier.sync();
-        if (uid == 0) {
-            auto correct = transactional(tm, Transaction::Mode::read_only, [&](Transaction& tx) {
-                Shared<size_t> counter{tx, tm.get_start()};
-                return counter == 0;
-            });
-            if (unlikely(!correct))
-                return "Violated consistency";
+        { // Last long transaction
+            size_t dummy;
+            if (!long_tx(dummy, buffer))
+                return "Violated isolation or atomicity";
         }
         return nullptr;
     }
+    /**
+     * Test in which we check that multiple concurrent transactions can decrease a counter in a sequential manner.
+     * @param uid Id of the thread to run the check
+    **/
+    virtual char const* check(Uid uid, Seed seed [[gnu::unused]]) const {
+        return check_counter(uid, nbworkers, barrier);
+    }
 };
@@ -0,0 +1,342 @@
+/**
+ * @file   tm_api.hpp
+ *
+ * @section DESCRIPTION
+ *
+ * Typed C++17 interface over a transaction manager: regions and transactions
+ * owned through RAII, 'stm::ref<T>' and 'stm::span<T>' to access words of
+ * shared memory by type and in bulk, and 'stm::atomically' retrying a body
+ * until it commits. Everything is inline and free of exceptions and virtual
+ * calls, each access being one call to the backend:
+ *   - 'stm::c_api' calls the functions of 'tm.hpp', resolved at link time;
+ *   - 'tm_engine::Direct<Engine>' (see 'tm_engine.hpp') calls an engine
+ *     compiled in the same program, so accesses inline completely.
+ * The word size of a region is part of its type, so that misaligned element
+ * types are rejected at compile time.
+ *
+ * It is kept apart from 'tm.hpp', which only declares the interface every
+ * library implements (and which the grading program includes in its own
+ * namespace). The namespace is 'stm', as '::tm' is the 'struct tm' of <time.h>.
+**/
+
+#pragma once
+
+// External headers
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+extern "C" {
+#include <sched.h>
+}
+
+// Internal headers
+#include <tm.hpp>
+
+// -------------------------------------------------------------------------- //
+
+namespace stm {
+
+/** Backend calling the library implementing 'tm.hpp'.
+**/
+struct c_api {
+    using handle = shared_t;
+    using tx = tx_t;
+    static constexpr handle invalid_handle = invalid_shared;
+    static constexpr tx invalid_tx = ::invalid_tx;
+    static handle create(size_t size, size_t align) noexcept {
+        return ::tm_create(size, align);
+    }
+    static void destroy(handle region) noexcept {
+        ::tm_destroy(region);
+    }
+    static void* start(handle region) noexcept {
+        return ::tm_start(region);
+    }
+    static size_t size(handle region) noexcept {
+        return ::tm_size(region);
+    }
+    static size_t align(handle region) noexcept {
+        return ::tm_align(region);
+    }
+    static tx begin(handle region, bool is_ro) noexcept {
+        return ::tm_begin(region, is_ro);
+    }
+    static bool end(handle region, tx id) noexcept {
+        return ::tm_end(region, id);
+    }
+    static bool read(handle region, tx id, void const* source, size_t size, void* target) noexcept {
+        return ::tm_read(region, id, source, size, target);
+    }
+    static bool write(handle region, tx id, void const* source, size_t size, void* target) noexcept {
+        return ::tm_write(region, id, source, size, target);
+    }
+    static Alloc alloc(handle region, tx id, size_t size, void** target) noexcept {
+        return ::tm_alloc(region, id, size, target);
+    }
+    static bool free(handle region, tx id, void* segment) noexcept {
+        return ::tm_free(region, id, segment);
+    }
+};
+
+/** Whether values of the given type can live in shared memory of the given word size.
+ * @param T     Element type
+ * @param Align Word size (in bytes)
+**/
+template<class T, size_t Align> constexpr bool fits_words = ::std::is_trivially_copyable_v<T> && sizeof(T) % Align == 0 && Align % alignof(T) == 0;
+
+template<class Backend, size_t Align> class basic_transaction;
+
+/** Typed reference to one element in shared memory.
+ * @param T       Element type
+ * @param Backend Transaction manager backend
+ * @param Align   Word size of the region (in bytes)
+**/
+template<class T, class Backend = c_api, size_t Align = alignof(T)> class ref final {
+    static_assert((Align & (Align - 1)) == 0, "word sizes are powers of two");
+    static_assert(fits_words<T, Align>, "elements must be trivially copyable and span whole, aligned words");
+private:
+    T* address;
+public:
+    constexpr explicit ref(T* address) noexcept: address{address} {}
+    constexpr T* get() const noexcept {
+        return address;
+    }
+    /** Read the element.
+     * @param tx     Running transaction, ended on abort
+     * @param target Value read
+     * @return Whether the transaction can continue
+    **/
+    [[nodiscard]] bool load(basic_transaction<Backend, Align>& tx, T& target) const noexcept {
+        return tx.read(address, sizeof(T), &target);
+    }
+    /** Write the element.
+     * @param tx    Running transaction, ended on abort
+     * @param value Value to write
+     * @return Whether the transaction can continue
+    **/
+    [[nodiscard]] bool store(basic_transaction<Backend, Align>& tx, T const& value) const noexcept {
+        return tx.write(&value, sizeof(T), address);
+    }
+};
+
+/** Typed view of contiguous elements in shared memory, accessed in bulk.
+ * @param T       Element type
+ * @param Backend Transaction manager backend
+ * @param Align   Word size of the region (in bytes)
+**/
+template<class T, class Backend = c_api, size_t Align = alignof(T)> class span final {
+    static_assert((Align & (Align - 1)) == 0, "word sizes are powers of two");
+    static_assert(fits_words<T, Align>, "elements must be trivially copyable and span whole, aligned words");
+private:
+    T* first;
+    size_t count;
+public:
+    constexpr span() noexcept: first{nullptr}, count{0} {}
+    constexpr span(T* first, size_t count) noexcept: first{first}, count{count} {}
+    constexpr T* data() const noexcept {
+        return first;
+    }
+    constexpr size_t size() const noexcept {
+        return count;
+    }
+    constexpr size_t size_bytes() const noexcept {
+        return count * sizeof(T);
+    }
+    constexpr bool empty() const noexcept {
+        return count == 0;
+    }
+    constexpr ref<T, Backend, Align> operator[](size_t index) const noexcept {
+        return ref<T, Backend, Align>{first + index};
+    }
+    constexpr span subspan(size_t offset, size_t length) const noexcept {
+        return span{first + offset, length};
+    }
+    /** Read every element, in one call to the backend.
+     * @param tx     Running transaction, ended on abort
+     * @param target Buffer of 'size()' elements
+     * @return Whether the transaction can continue
+    **/
+    [[nodiscard]] bool load(basic_transaction<Backend, Align>& tx, T* target) const noexcept {
+        return count == 0 || tx.read(first, size_bytes(), target);
+    }
+    /** Write every element, in one call to the backend.
+     * @param tx     Running transaction, ended on abort
+     * @param source Buffer of 'size()' elements
+     * @return Whether the transaction can continue
+    **/
+    [[nodiscard]] bool store(basic_transaction<Backend, Align>& tx, T const* source) const noexcept {
+        return count == 0 || tx.write(source, size_bytes(), first);
+    }
+};
+
+/** Shared memory region, destroyed with its owner.
+ * @param Backend Transaction manager backend
+ * @param Align   Word size (in bytes)
+**/
+template<class Backend, size_t Align> class basic_region final {
+    static_assert(Align > 0 && (Align & (Align - 1)) == 0, "word sizes are powers of two");
+private:
+    typename Backend::handle region;
+public:
+    static constexpr size_t align = Align;
+    /** Create a region.
+     * @param size Size of its first segment (in bytes, a multiple of 'Align')
+    **/
+    explicit basic_region(size_t size) noexcept: region{Backend::create(size, Align)} {}
+    basic_region(basic_region&& other) noexcept: region{::std::exchange(other.region, Backend::invalid_handle)} {}
+    basic_region& operator=(basic_region&& other) noexcept {
+        ::std::swap(region, other.region);
+        return *this;
+    }
+    basic_region(basic_region const&) = delete;
+    basic_region& operator=(basic_region const&) = delete;
+    ~basic_region() noexcept {
+        if (region != Backend::invalid_handle)
+            Backend::destroy(region);
+    }
+    /** Whether the region was created.
+    **/
+    explicit operator bool() const noexcept {
+        return region != Backend::invalid_handle;
+    }
+    typename Backend::handle handle() const noexcept {
+        return region;
+    }
+    /** First segment, as elements of the given type.
+    **/
+    template<class T> span<T, Backend, Align> start() const noexcept {
+        return span<T, Backend, Align>{static_cast<T*>(Backend::start(region)), Backend::size(region) / sizeof(T)};
+    }
+};
+
+/** Running transaction, ended when it goes out of scope. As the interface has
+ * no explicit abort, a transaction still running then is committed.
+ * @param Backend Transaction manager backend
+ * @param Align   Word size of the region (in bytes)
+**/
+template<class Backend, size_t Align> class basic_transaction {
+protected:
+    typename Backend::handle region;
+    typename Backend::tx id; // 'Backend::invalid_tx' once ended
+public:
+    basic_transaction(basic_region<Backend, Align> const& region, bool is_ro) noexcept: region{region.handle()}, id{Backend::begin(region.handle(), is_ro)} {}
+    /** Take over a transaction begun on the given region.
+    **/
+    basic_transaction(typename Backend::handle region, typename Backend::tx id) noexcept: region{region}, id{id} {}
+    basic_transaction(basic_transaction&& other) noexcept: region{other.region}, id{::std::exchange(other.id, Backend::invalid_tx)} {}
+    basic_transaction& operator=(basic_transaction&&) = delete;
+    basic_transaction(basic_transaction const&) = delete;
+    basic_transaction& operator=(basic_transaction const&) = delete;
+    ~basic_transaction() noexcept {
+        if (id != Backend::invalid_tx)
+            Backend::end(region, id);
+    }
+    /** Whether the transaction is running, i.e. neither aborted nor ended.
+    **/
+    explicit operator bool() const noexcept {
+        return id != Backend::invalid_tx;
+    }
+    /** Try to commit the transaction, which ends it.
+     * @return Whether it committed, 'false' without calling the backend once aborted
+    **/
+    [[nodiscard]] bool commit() noexcept {
+        if (id == Backend::invalid_tx)
+            return false;
+        return Backend::end(region, ::std::exchange(id, Backend::invalid_tx));
+    }
+    /** Accesses below report an abort without calling the backend once the transaction ended.
+    **/
+    [[nodiscard]] bool read(void const* source, size_t size, void* target) noexcept {
+        if (id == Backend::invalid_tx)
+            return false;
+        if (Backend::read(region, id, source, size, target))
+            return true;
+        id = Backend::invalid_tx;
+        return false;
+    }
+    [[nodiscard]] bool write(void const* source, size_t size, void* target) noexcept {
+        if (id == Backend::invalid_tx)
+            return false;
+        if (Backend::write(region, id, source, size, target))
+            return true;
+        id = Backend::invalid_tx;
+        return false;
+    }
+    /** Allocate a segment of the given number of elements.
+     * @param count  Number of elements
+     * @param target Segment allocated, on success
+     * @return 'Alloc::success', 'Alloc::nomem' (the transaction continues) or 'Alloc::abort'
+    **/
+    template<class T> [[nodiscard]] Alloc alloc(size_t count, span<T, Backend, Align>& target) noexcept {
+        if (id == Backend::invalid_tx)
+            return Alloc::abort;
+        void* segment;
+        auto res = Backend::alloc(region, id, count * sizeof(T), &segment);
+        if (res == Alloc::success) {
+            target = span<T, Backend, Align>{static_cast<T*>(segment), count};
+        } else if (res == Alloc::abort) {
+            id = Backend::invalid_tx;
+        }
+        return res;
+    }
+    /** Free a segment allocated through 'alloc', on commit.
+    **/
+    template<class T> [[nodiscard]] bool free(span<T, Backend, Align> segment) noexcept {
+        if (id == Backend::invalid_tx)
+            return false;
+        if (Backend::free(region, id, segment.data()))
+            return true;
+        id = Backend::invalid_tx;
+        return false;
+    }
+};
+
+/** Backoff between attempts, doubling the number of yields up to a bound.
+**/
+class exponential_backoff final {
+private:
+    unsigned int next;
+    unsigned int limit;
+public:
+    constexpr explicit exponential_backoff(unsigned int first = 1, unsigned int limit = 1024) noexcept: next{first}, limit{limit} {}
+    void operator()() noexcept {
+        for (auto i = next; i > 0; --i)
+            ::sched_yield();
+        if (next < limit)
+            next <<= 1;
+    }
+};
+
+/** Backoff retrying at once.
+**/
+struct no_backoff {
+    constexpr void operator()() const noexcept {}
+};
+
+/** Run the body in a transaction until it commits, trying again whenever the
+ * transaction aborts.
+ * @param region  Region to run the transaction on
+ * @param is_ro   Whether the transaction is read-only
+ * @param body    Called with the transaction, returning 'false' as soon as an access reports an abort
+ * @param backoff Called between attempts
+ * @return What the body returned in the attempt that committed, 'false' if no transaction could be started
+**/
+template<class Backend, size_t Align, class Body, class Backoff = exponential_backoff> bool atomically(basic_region<Backend, Align> const& region, bool is_ro, Body&& body, Backoff backoff = Backoff{}) noexcept(noexcept(body(::std::declval<basic_transaction<Backend, Align>&>()))) {
+    while (true) {
+        basic_transaction<Backend, Align> tx{region, is_ro};
+        if (!tx)
+            return false;
+        auto done = body(tx);
+        if (tx && tx.commit()) // Still running if the body gave up by itself
+            return done;
+        backoff();
+    }
+}
+
+/** Region and transaction of the library implementing 'tm.hpp'.
+**/
+template<size_t Align> using region = basic_region<c_api, Align>;
+template<size_t Align> using transaction = basic_transaction<c_api, Align>;
+
+}
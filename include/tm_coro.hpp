@@ -0,0 +1,334 @@
+/**
+ * @file   tm_coro.hpp
+ *
+ * @section DESCRIPTION
+ *
+ * C++20 coroutine interface over the batcher-based transaction manager of
+ * 'src/', for event loops driving many transactions from a few threads:
+ *
+ *     auto tx = co_await stm::begin(region, executor);
+ *     ... tx.read / ref::load / span::store, as with 'tm_api.hpp' ...
+ *     co_await tx.commit();
+ *
+ * Rather than spinning, a transaction waiting for a write slot in the current
+ * epoch, or for the epoch to commit its writes, registers its continuation
+ * with the batcher (see 'tm_begin_async'). The thread committing the epoch
+ * then posts it to the executor given, which resumes it on one of its own
+ * threads. Turns are only held for a few instructions and are still waited for.
+ *
+ * An executor is anything with 'post(std::coroutine_handle<>)'. As it is
+ * called while the batcher is held, 'post' must only queue the coroutine,
+ * never resume it in place. 'stm::run_queue' is such an executor, run by any
+ * number of threads.
+**/
+
+#pragma once
+
+#if __cplusplus < 202002L || !__has_include(<coroutine>)
+#error "tm_coro.hpp requires C++20 coroutines"
+#endif
+
+// External headers
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Internal headers
+#include <tm_api.hpp>
+
+// -------------------------------------------------------------------------- //
+
+extern "C" {
+    struct tm_resume { // Same layout as 'tm_resume_t' in 'tm_ext.h'
+        void (*resume)(void*);
+        void* arg;
+        tm_resume* next;
+    };
+    tx_t tm_begin_async(shared_t, bool, tm_resume*) noexcept;
+    bool tm_end_async(shared_t, tx_t, tm_resume*) noexcept;
+}
+
+namespace stm {
+
+/** Scheduler of coroutines ready to run.
+**/
+template<class Executor> concept executor = requires(Executor& executor, ::std::coroutine_handle<> handle) {
+    executor.post(handle);
+};
+
+/** Executor queueing coroutines for the threads running it.
+**/
+class run_queue final {
+private:
+    ::std::mutex lock;
+    ::std::condition_variable ready;
+    ::std::deque<::std::coroutine_handle<>> queue;
+    bool stopped = false;
+public:
+    /** Queue a coroutine, resumed by a thread running the queue.
+    **/
+    void post(::std::coroutine_handle<> handle) {
+        {
+            ::std::lock_guard<::std::mutex> guard{lock};
+            queue.push_back(handle);
+        }
+        ready.notify_one();
+    }
+    /** Resume coroutines as they are queued, until stopped and empty.
+    **/
+    void run() {
+        while (true) {
+            ::std::coroutine_handle<> handle;
+            {
+                ::std::unique_lock<::std::mutex> guard{lock};
+                ready.wait(guard, [&]() { return stopped || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                handle = queue.front();
+                queue.pop_front();
+            }
+            handle.resume();
+        }
+    }
+    /** Make 'run' return once no coroutine is queued.
+    **/
+    void stop() {
+        {
+            ::std::lock_guard<::std::mutex> guard{lock};
+            stopped = true;
+        }
+        ready.notify_all();
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Lazily started coroutine, resuming its awaiter once done. Exceptions are
+ * not propagated: the whole interface is 'noexcept'.
+ * @param T Type of the result
+**/
+template<class T = void> class task;
+
+namespace detail {
+
+class promise_base {
+public:
+    ::std::coroutine_handle<> continuation; // Awaiter, if any
+    bool detached = false;                  // Whether the frame is destroyed once done
+private:
+    struct final_awaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+        template<class Promise> ::std::coroutine_handle<> await_suspend(::std::coroutine_handle<Promise> self) noexcept {
+            auto& promise = self.promise();
+            if (promise.continuation)
+                return promise.continuation;
+            if (promise.detached)
+                self.destroy();
+            return ::std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+public:
+    ::std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+    final_awaiter final_suspend() const noexcept {
+        return {};
+    }
+    void unhandled_exception() const noexcept {
+        ::std::terminate();
+    }
+};
+
+template<class T> class promise final: public promise_base {
+public:
+    ::std::optional<T> value;
+    task<T> get_return_object() noexcept;
+    template<class V> void return_value(V&& result) {
+        value.emplace(::std::forward<V>(result));
+    }
+};
+
+template<> class promise<void> final: public promise_base {
+public:
+    task<void> get_return_object() noexcept;
+    void return_void() const noexcept {}
+};
+
+/** Continuation registered with the batcher, posted to an executor by the
+ * thread committing the epoch waited for.
+**/
+template<class Executor> class resumption final {
+private:
+    tm_resume node;
+    Executor* executor;
+    ::std::coroutine_handle<> handle;
+    bool called; // Whether the epoch waited for is over
+    static void call(void* self) noexcept {
+        auto& target = *static_cast<resumption*>(self);
+        target.called = true;
+        target.executor->post(target.handle); // Possibly resumed, and gone, from here
+    }
+public:
+    explicit resumption(Executor& executor) noexcept: node{call, nullptr, nullptr}, executor{&executor}, handle{}, called{false} {}
+    resumption(resumption const&) = delete;
+    resumption& operator=(resumption const&) = delete;
+    /** Continuation resuming the given coroutine, to register with the batcher.
+    **/
+    tm_resume* arm(::std::coroutine_handle<> awaiter) noexcept {
+        node.arg = this;
+        handle = awaiter;
+        return &node;
+    }
+    /** Whether the continuation was called, read once resumed.
+    **/
+    bool done() const noexcept {
+        return called;
+    }
+};
+
+}
+
+template<class T> class task final {
+public:
+    using promise_type = detail::promise<T>;
+private:
+    ::std::coroutine_handle<promise_type> handle;
+public:
+    explicit task(::std::coroutine_handle<promise_type> handle) noexcept: handle{handle} {}
+    task(task&& other) noexcept: handle{::std::exchange(other.handle, nullptr)} {}
+    task& operator=(task&& other) noexcept {
+        ::std::swap(handle, other.handle);
+        return *this;
+    }
+    task(task const&) = delete;
+    task& operator=(task const&) = delete;
+    ~task() noexcept {
+        if (handle)
+            handle.destroy();
+    }
+    /** Start the coroutine and resume the awaiter with its result once done.
+    **/
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            ::std::coroutine_handle<promise_type> handle;
+            bool await_ready() const noexcept {
+                return !handle || handle.done();
+            }
+            ::std::coroutine_handle<> await_suspend(::std::coroutine_handle<> continuation) noexcept {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+            T await_resume() const noexcept {
+                if constexpr (!::std::is_void_v<T>)
+                    return ::std::move(*handle.promise().value);
+            }
+        };
+        return awaiter{handle};
+    }
+    /** Give the coroutine up, to be started once and destroyed when done.
+    **/
+    ::std::coroutine_handle<promise_type> release() noexcept {
+        handle.promise().detached = true;
+        return ::std::exchange(handle, nullptr);
+    }
+};
+
+template<class T> task<T> detail::promise<T>::get_return_object() noexcept {
+    return task<T>{::std::coroutine_handle<promise>::from_promise(*this)};
+}
+
+inline task<void> detail::promise<void>::get_return_object() noexcept {
+    return task<void>{::std::coroutine_handle<promise>::from_promise(*this)};
+}
+
+/** Run a coroutine on the given executor, without waiting for it.
+**/
+template<executor Executor> void spawn(Executor& executor, task<void> body) {
+    executor.post(body.release());
+}
+
+// -------------------------------------------------------------------------- //
+
+/** Running transaction of a coroutine, committed with 'co_await commit()'. One
+ * still running when going out of scope is committed in place, waiting for its
+ * epoch as the thread of 'basic_transaction' does.
+ * @param Executor Executor resuming the coroutine
+ * @param Align    Word size of the region (in bytes)
+**/
+template<executor Executor, size_t Align> class basic_async_transaction final: public basic_transaction<c_api, Align> {
+private:
+    Executor* executor;
+public:
+    basic_async_transaction(shared_t region, tx_t id, Executor& executor) noexcept: basic_transaction<c_api, Align>{region, id}, executor{&executor} {}
+    /** Commit the transaction, which ends it, suspending the coroutine until its epoch did.
+     * @return Awaitable of whether it committed
+    **/
+    [[nodiscard]] auto commit() noexcept {
+        struct awaiter {
+            shared_t region;
+            tx_t id; // 'invalid_tx' if aborted
+            detail::resumption<Executor> resumption;
+            bool committed = false; // Whether 'tm_end_async' reported the commit without suspending
+            bool await_ready() const noexcept {
+                return id == invalid_tx;
+            }
+            bool await_suspend(::std::coroutine_handle<> self) noexcept {
+                if (!::tm_end_async(region, id, resumption.arm(self)))
+                    return true; // Resumed by the commit of the epoch, possibly already
+                committed = true;
+                return false;
+            }
+            bool await_resume() const noexcept {
+                return committed || resumption.done();
+            }
+        };
+        return awaiter{this->region, ::std::exchange(this->id, invalid_tx), detail::resumption<Executor>{*executor}};
+    }
+};
+
+/** Begin a transaction on the first domain of the region, suspending the
+ * coroutine while the current epoch has no room for it.
+ * @param region   Region to run the transaction on
+ * @param executor Executor resuming the coroutine
+ * @param is_ro    Whether the transaction is read-only
+ * @return Running transaction
+**/
+template<executor Executor, size_t Align> task<basic_async_transaction<Executor, Align>> begin(basic_region<c_api, Align> const& region, Executor& executor, bool is_ro = false) {
+    struct attempt {
+        shared_t region;
+        bool is_ro;
+        detail::resumption<Executor> resumption;
+        tx_t id = invalid_tx;
+        bool await_ready() const noexcept {
+            return false;
+        }
+        bool await_suspend(::std::coroutine_handle<> self) noexcept {
+            auto tx = ::tm_begin_async(region, is_ro, resumption.arm(self));
+            if (tx == invalid_tx)
+                return true; // Resumed by the commit of the epoch, possibly already
+            id = tx;
+            return false;
+        }
+        tx_t await_resume() const noexcept {
+            return id;
+        }
+    };
+    while (true) {
+        auto id = co_await attempt{region.handle(), is_ro, detail::resumption<Executor>{executor}};
+        if (id != invalid_tx)
+            co_return basic_async_transaction<Executor, Align>{region.handle(), id, executor};
+    }
+}
+
+/** Transaction of a coroutine run by a 'stm::run_queue'.
+**/
+template<size_t Align> using async_transaction = basic_async_transaction<run_queue, Align>;
+
+}
@@ -0,0 +1,1497 @@
+/**
+ * @file   tm_engine.hpp
+ *
+ * @section DESCRIPTION
+ *
+ * Header-only transaction manager engine (C++17 version), assembled at
+ * compile time from four policies:
+ *   - versioning: 'Shadow' (per-word shadow copy), 'RedoLog' (private write
+ *     set written back on commit), 'UndoLog' (in-place writes, old values
+ *     restored on abort);
+ *   - conflict detection: 'PerWord' and 'Striped<Bits>' (visible readers and
+ *     writers on one record per word, or per hashed stripe), 'InvisibleReads'
+ *     (per-word versioned locks and a global version clock, reads validated),
+ *     'ValueValidation' (a global sequence lock, reads validated by value);
+ *   - admission: 'TicketBatcher<Slots>' (epochs admitting at most 'Slots'
+ *     read-write transactions, as the batcher in 'src/'), 'ScalableBatcher'
+ *     (per-thread epoch announcements, no shared ticket), 'NoAdmission';
+ *   - waiting: 'Spin', 'Yield', 'Futex'.
+ * A library picks one combination and exports the interface of 'tm.hpp' with
+ * TM_ENGINE_EXPORT. Every policy is a template argument, so nothing is
+ * dispatched at runtime.
+**/
+
+#pragma once
+
+// External headers
+extern "C" {
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Internal headers
+#include <tm.hpp>
+
+// -------------------------------------------------------------------------- //
+namespace tm_engine {
+
+using Record = ::std::atomic<uint64_t>; // Metadata guarding one word or one stripe of words
+
+/** Bytes of address space reserved for the segments of one region, and as much
+ * again for shadow copies when the versioning policy needs them.
+**/
+#ifndef TM_ENGINE_CAPACITY
+#define TM_ENGINE_CAPACITY (size_t{1} << 34)
+#endif
+
+/** Make room for the given number of elements more, growing geometrically,
+ * so that adding them afterwards cannot throw.
+**/
+template<class T> void reserve_more(::std::vector<T>& items, size_t count = 1) {
+    if (items.capacity() - items.size() < count)
+        items.reserve(::std::max(items.capacity() * 2, items.size() + count));
+}
+
+// -------------------------------------------------------------------------- //
+// Waiting policies
+
+/** Busy-waits, for machines with a core per thread.
+**/
+struct Spin {
+    static void relax() noexcept {
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+    }
+    void wait(::std::atomic<uint32_t>& word, uint32_t old) noexcept {
+        while (word.load(::std::memory_order_acquire) == old)
+            relax();
+    }
+    void wake(::std::atomic<uint32_t>&) noexcept {}
+};
+
+/** Gives the CPU away while waiting, as 'relinquish_cpu' in 'src/'.
+**/
+struct Yield {
+    static void relax() noexcept {
+        ::sched_yield();
+    }
+    void wait(::std::atomic<uint32_t>& word, uint32_t old) noexcept {
+        while (word.load(::std::memory_order_acquire) == old)
+            relax();
+    }
+    void wake(::std::atomic<uint32_t>&) noexcept {}
+};
+
+/** Sleeps in the kernel once a short spin is over, wakers only making a system
+ * call when someone sleeps.
+**/
+struct Futex {
+    static_assert(sizeof(::std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit words");
+    static constexpr int spins = 64;
+    ::std::atomic<uint32_t> sleepers{0};
+    static void relax() noexcept {
+        ::sched_yield();
+    }
+    void wait(::std::atomic<uint32_t>& word, uint32_t old) noexcept {
+        for (int i = 0; i < spins; ++i) {
+            if (word.load(::std::memory_order_acquire) != old)
+                return;
+            relax();
+        }
+        sleepers.fetch_add(1);
+        while (word.load() == old)
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, old, nullptr, nullptr, 0);
+        sleepers.fetch_sub(1);
+    }
+    void wake(::std::atomic<uint32_t>& word) noexcept {
+        if (sleepers.load() != 0)
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Transaction-private sets
+
+/** Set of addresses, cleared in constant time between transactions.
+**/
+class AddressSet final {
+private:
+    struct Slot {
+        uintptr_t key = 0;
+        uint64_t generation = 0;
+    };
+    ::std::vector<Slot> slots = ::std::vector<Slot>(64);
+    ::std::vector<uintptr_t> keys; // In insertion order
+    uint64_t generation = 1;
+    size_t find(uintptr_t key) const noexcept {
+        auto mask = slots.size() - 1;
+        auto i = (key * 0x9e3779b97f4a7c15ul >> 20) & mask;
+        while (slots[i].generation == generation && slots[i].key != key)
+            i = (i + 1) & mask;
+        return i;
+    }
+    void grow() {
+        ::std::vector<Slot> old(slots.size() << 1);
+        old.swap(slots);
+        ++generation;
+        for (auto key: keys)
+            slots[find(key)] = Slot{key, generation};
+    }
+public:
+    /** Insert an address.
+     * @param address Address to insert
+     * @return Whether it was not in the set yet
+    **/
+    bool insert(void const* address) {
+        auto key = reinterpret_cast<uintptr_t>(address);
+        auto i = find(key);
+        if (slots[i].generation == generation)
+            return false;
+        slots[i] = Slot{key, generation};
+        keys.push_back(key);
+        if (keys.size() * 2 > slots.size())
+            grow();
+        return true;
+    }
+    /** Make room for one more address, so that inserting it cannot throw.
+    **/
+    void reserve() {
+        reserve_more(keys);
+        if ((keys.size() + 1) * 2 > slots.size())
+            grow();
+    }
+    bool contains(void const* address) const noexcept {
+        auto i = find(reinterpret_cast<uintptr_t>(address));
+        return slots[i].generation == generation;
+    }
+    auto const& items() const noexcept {
+        return keys;
+    }
+    size_t size() const noexcept {
+        return keys.size();
+    }
+    void clear() noexcept {
+        keys.clear();
+        ++generation;
+    }
+};
+
+/** Map from word addresses to their private value, cleared in constant time.
+**/
+class WordMap final {
+private:
+    struct Slot {
+        uintptr_t key = 0;
+        uint64_t generation = 0;
+        size_t entry = 0;
+    };
+    ::std::vector<Slot> slots = ::std::vector<Slot>(64);
+    ::std::vector<uintptr_t> keys; // In insertion order
+    ::std::vector<char> values;    // One word per key
+    uint64_t generation = 1;
+    size_t find(uintptr_t key) const noexcept {
+        auto mask = slots.size() - 1;
+        auto i = (key * 0x9e3779b97f4a7c15ul >> 20) & mask;
+        while (slots[i].generation == generation && slots[i].key != key)
+            i = (i + 1) & mask;
+        return i;
+    }
+    void grow() {
+        ::std::vector<Slot> old(slots.size() << 1);
+        old.swap(slots);
+        ++generation;
+        for (size_t entry = 0; entry < keys.size(); ++entry)
+            slots[find(keys[entry])] = Slot{keys[entry], generation, entry};
+    }
+public:
+    /** Private value of a word.
+     * @param address Word address
+     * @param align   Word length (in bytes)
+     * @return Value, 'nullptr' when the word was not written
+    **/
+    char* find(void const* address, size_t align) noexcept {
+        auto i = find(reinterpret_cast<uintptr_t>(address));
+        if (slots[i].generation != generation)
+            return nullptr;
+        return values.data() + slots[i].entry * align;
+    }
+    /** Set the private value of a word.
+     * @param address Word address
+     * @param source  New value
+     * @param align   Word length (in bytes)
+    **/
+    void put(void const* address, void const* source, size_t align) {
+        auto key = reinterpret_cast<uintptr_t>(address);
+        auto i = find(key);
+        if (slots[i].generation == generation) {
+            ::std::memcpy(values.data() + slots[i].entry * align, source, align);
+            return;
+        }
+        slots[i] = Slot{key, generation, keys.size()};
+        keys.push_back(key);
+        values.insert(values.end(), static_cast<char const*>(source), static_cast<char const*>(source) + align);
+        if (keys.size() * 2 > slots.size())
+            grow();
+    }
+    auto const& items() const noexcept {
+        return keys;
+    }
+    char const* value(size_t entry, size_t align) const noexcept {
+        return values.data() + entry * align;
+    }
+    void clear() noexcept {
+        keys.clear();
+        values.clear();
+        ++generation;
+    }
+};
+
+/** Transaction descriptor, its address being the transaction identifier. The
+ * policies only use the parts they need.
+**/
+struct Transaction final {
+    bool is_ro;
+    uint64_t rv = 0;                                     // Version clock at start (invisible reads)
+    uint64_t wv = 0;                                     // Version clock at commit (invisible reads)
+    AddressSet reads;                                    // Records read
+    ::std::vector<Record*> counted;                      // Records read-only transactions counted as readers, once per read
+    ::std::vector<::std::pair<Record*, uint64_t>> locks; // Records write-locked, with their previous value
+    AddressSet written;                                  // Words written (shadow)
+    WordMap redo;                                        // Words written with their new value (redo log)
+    ::std::vector<uintptr_t> undo;                       // Words written in place (undo log)
+    ::std::vector<char> undo_values;                     // Their previous value, one word each
+    ::std::vector<::std::pair<uintptr_t, size_t>> logged; // Ranges read, with their length (value validation)
+    ::std::vector<char> logged_values;                   // Their value when read, one after the other
+    ::std::vector<void*> allocs;                         // Segments allocated
+    ::std::vector<void*> frees;                          // Segments freed
+    void reset(bool ro) noexcept {
+        is_ro = ro;
+        wv = 0;
+        reads.clear();
+        counted.clear();
+        locks.clear();
+        written.clear();
+        redo.clear();
+        undo.clear();
+        undo_values.clear();
+        logged.clear();
+        logged_values.clear();
+        allocs.clear();
+        frees.clear();
+    }
+};
+
+/** Values announced by running transactions, one slot per thread, so that
+ * others can tell the oldest one still in use without a shared counter.
+**/
+class Announcements final {
+public:
+    static constexpr size_t max_threads = 1024;
+private:
+    struct alignas(64) Slot {
+        ::std::atomic<uint64_t> value{0}; // Announced value plus one, 0 when idle
+        uint64_t depth = 0;               // Transactions of the owner thread running, only used by it
+    };
+    ::std::unique_ptr<Slot[]> slots{new Slot[max_threads]};
+    ::std::atomic<uint64_t> overflow{0}; // Transactions of threads beyond 'max_threads'
+    static ::std::atomic<size_t>& claimed() noexcept {
+        static ::std::atomic<size_t> claimed{0}; // Slots ever claimed, bounding the scans
+        return claimed;
+    }
+    /** Slot of the calling thread, 'max_threads' when none is left.
+    **/
+    static size_t index() noexcept {
+        static ::std::atomic<bool> used[max_threads];
+        thread_local struct Holder {
+            size_t index = max_threads;
+            Holder() noexcept {
+                for (size_t i = 0; i < max_threads; ++i) {
+                    bool expected = false;
+                    if (used[i].compare_exchange_strong(expected, true)) {
+                        index = i;
+                        auto high = claimed().load();
+                        while (high <= i && !claimed().compare_exchange_weak(high, i + 1)) {}
+                        break;
+                    }
+                }
+            }
+            ~Holder() noexcept {
+                if (index < max_threads)
+                    used[index].store(false);
+            }
+        } holder;
+        return holder.index;
+    }
+public:
+    /** Announce the current value of the given counter, until 'withdraw'. The
+     * announcement is sequentially consistent and checked against the counter,
+     * so a 'minimum' that misses it read a counter no greater. Transactions
+     * nested in the same thread keep the first announcement.
+     * @param counter Non-decreasing counter
+     * @return Value announced
+    **/
+    uint64_t announce(::std::atomic<uint64_t> const& counter) noexcept {
+        auto index = Announcements::index();
+        if (index == max_threads) {
+            overflow.fetch_add(1);
+            return counter.load();
+        }
+        auto& slot = slots[index];
+        if (slot.depth++ > 0)
+            return slot.value.load(::std::memory_order_relaxed) - 1;
+        auto current = counter.load();
+        while (true) {
+            slot.value.store(current + 1);
+            auto again = counter.load();
+            if (again == current)
+                return current;
+            current = again;
+        }
+    }
+    void withdraw() noexcept {
+        auto index = Announcements::index();
+        if (index == max_threads) {
+            overflow.fetch_sub(1);
+            return;
+        }
+        if (--slots[index].depth == 0)
+            slots[index].value.store(0, ::std::memory_order_release);
+    }
+    /** Smallest value announced, or the current value of the counter when smaller.
+     * @param counter Counter the values were announced from
+     * @return Smallest value, 0 while threads without slot run transactions
+    **/
+    uint64_t minimum(::std::atomic<uint64_t> const& counter) noexcept {
+        auto minimum = counter.load();
+        if (overflow.load() != 0)
+            return 0;
+        auto high = claimed().load();
+        for (size_t i = 0; i < high; ++i) {
+            auto announced = slots[i].value.load();
+            if (announced != 0 && announced - 1 < minimum)
+                minimum = announced - 1;
+        }
+        return minimum;
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Versioning policies
+
+/** Writes go to a shadow copy of each word, mirroring the data area, and are
+ * copied over the data on commit. Words are locked on first write.
+**/
+struct Shadow {
+    static constexpr bool shadow_area = true; // Whether a shadow area is reserved
+    static constexpr bool eager = true;       // Whether words are locked when written
+    static constexpr bool in_place = false;   // Whether the data holds uncommitted values
+    static constexpr bool chains = false;     // Whether words keep their committed versions
+};
+
+/** Writes are kept in a private write set and written back on commit, words
+ * being locked only then.
+**/
+struct RedoLog {
+    static constexpr bool shadow_area = false;
+    static constexpr bool eager = false;
+    static constexpr bool in_place = false;
+    static constexpr bool chains = false;
+};
+
+/** Writes go in place once the word is locked, its previous value being
+ * logged and restored on abort.
+**/
+struct UndoLog {
+    static constexpr bool shadow_area = false;
+    static constexpr bool eager = true;
+    static constexpr bool in_place = true;
+    static constexpr bool chains = false;
+};
+
+/** Writes are buffered as with 'RedoLog', and each word also keeps a chain of
+ * its last committed versions, newest first. Read-only transactions read the
+ * snapshot published when they started from the chains, never touching locks
+ * nor waiting. Versions no snapshot still needs are dropped as new ones are
+ * written, and freed once the snapshots that could see them have ended; at
+ * most 'Versions' are kept per word, older snapshots then aborting.
+ * Requires 'InvisibleReads', for the write versions.
+**/
+template<unsigned Versions = 8> class MultiVersion {
+public:
+    static constexpr bool shadow_area = false;
+    static constexpr bool eager = false;
+    static constexpr bool in_place = false;
+    static constexpr bool chains = true;
+    static_assert(Versions > 0, "at least the last committed version is kept");
+    /** Committed version of a word, its value following it.
+    **/
+    struct alignas(16) Version {
+        uint64_t version;
+        ::std::atomic<Version*> next;
+        bool truncated; // Whether older versions were dropped, when last of its chain
+        char* value() noexcept {
+            return reinterpret_cast<char*>(this + 1);
+        }
+    };
+    using Chain = ::std::atomic<Version*>;
+private:
+    ::std::atomic<uint64_t> published{0}; // Write versions below are all in the chains
+    Announcements snapshots;              // Snapshots of running read-only transactions
+    ::std::mutex retired_lock;
+    ::std::vector<::std::pair<uint64_t, Version*>> retired; // Unlinked versions, stamped
+public:
+    /** Start a read-only transaction on the last published snapshot.
+    **/
+    void enter(Transaction& tx) noexcept {
+        tx.rv = snapshots.announce(published);
+    }
+    void leave(Transaction&) noexcept {
+        snapshots.withdraw();
+    }
+    /** Oldest snapshot still readable, the versions before the last one it sees being unneeded.
+    **/
+    uint64_t floor() noexcept {
+        return snapshots.minimum(published);
+    }
+    /** Read one word of the snapshot of the transaction.
+     * @return Whether the version was still kept
+    **/
+    bool read(Transaction& tx, Chain& chain, void* output, size_t align) noexcept {
+        auto version = chain.load(::std::memory_order_acquire);
+        while (version && version->version > tx.rv) {
+            auto next = version->next.load(::std::memory_order_acquire);
+            if (!next && version->truncated)
+                return false;
+            version = next;
+        }
+        if (version) {
+            ::std::memcpy(output, version->value(), align);
+        } else {
+            ::std::memset(output, 0, align); // Never written since the segment was allocated
+        }
+        return true;
+    }
+    /** Allocate the versions a commit installs, and room for the ones it
+     * drops, so that installing them cannot fail halfway.
+     * @param count    Number of words written
+     * @param nodes    Versions allocated
+     * @param unlinked Versions dropped, to give to 'retire'
+     * @return Whether everything could be allocated
+    **/
+    bool prepare(size_t count, size_t align, ::std::vector<Version*>& nodes, ::std::vector<Version*>& unlinked) noexcept {
+        try {
+            nodes.reserve(count);
+            unlinked.reserve(count * Versions);
+            while (nodes.size() < count)
+                nodes.push_back(static_cast<Version*>(::operator new(sizeof(Version) + align)));
+            return true;
+        } catch (::std::bad_alloc const&) {
+            for (auto node: nodes)
+                ::operator delete(node);
+            nodes.clear();
+            return false;
+        }
+    }
+    /** Prepend a committed version, dropping the ones no snapshot needs.
+     * @param node     Version allocated by 'prepare'
+     * @param unlinked Versions dropped, room for them made by 'prepare'
+    **/
+    void install(Chain& chain, Version* node, void const* value, size_t align, uint64_t version, uint64_t floor, ::std::vector<Version*>& unlinked) noexcept {
+        node->version = version;
+        node->truncated = false;
+        ::std::memcpy(node->value(), value, align);
+        auto head = chain.load(::std::memory_order_relaxed);
+        node->next.store(head, ::std::memory_order_relaxed);
+        chain.store(node, ::std::memory_order_release);
+        // Keep up to the first version the oldest snapshot sees, and no more than 'Versions'
+        unsigned count = 1;
+        auto last = node;
+        while (true) {
+            auto next = last->next.load(::std::memory_order_relaxed);
+            if (!next)
+                return;
+            if (last->version <= floor || count == Versions) {
+                if (last->version > floor)
+                    last->truncated = true;
+                last->next.store(nullptr, ::std::memory_order_release);
+                for (; next; next = next->next.load(::std::memory_order_relaxed))
+                    unlinked.push_back(next);
+                return;
+            }
+            last = next;
+            ++count;
+        }
+    }
+    /** Drop every version of a word, when its segment is reused.
+    **/
+    void forget(Chain& chain, ::std::vector<Version*>& unlinked) {
+        for (auto version = chain.exchange(nullptr); version; version = version->next.load(::std::memory_order_relaxed))
+            unlinked.push_back(version);
+    }
+    /** Publish a write version once every smaller one was, readers taking their snapshots from them.
+    **/
+    template<class Waiting> void publish(uint64_t version) noexcept {
+        while (published.load(::std::memory_order_acquire) != version - 2)
+            Waiting::relax();
+        published.store(version, ::std::memory_order_release);
+    }
+    /** Free the versions unlinked once no running snapshot can be reading
+     * them. Versions that cannot be recorded for lack of memory are leaked.
+    **/
+    void retire(::std::vector<Version*>& unlinked) noexcept {
+        auto stamp = published.load();
+        auto oldest = floor();
+        ::std::vector<Version*> freed;
+        {
+            ::std::lock_guard<::std::mutex> guard{retired_lock};
+            try {
+                reserve_more(retired, unlinked.size());
+                freed.reserve(retired.size() + unlinked.size());
+            } catch (::std::bad_alloc const&) {
+                unlinked.clear();
+                return;
+            }
+            for (auto version: unlinked)
+                retired.emplace_back(stamp, version);
+            for (size_t i = 0; i < retired.size();) {
+                if (retired[i].first < oldest) {
+                    freed.push_back(retired[i].second);
+                    retired[i] = retired.back();
+                    retired.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+        }
+        unlinked.clear();
+        for (auto version: freed)
+            ::operator delete(version);
+    }
+    ~MultiVersion() noexcept {
+        for (auto& [stamp, version]: retired)
+            ::operator delete(version);
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Conflict detection policies
+
+/** Visible readers and writers: a record counts the readers of what it guards,
+ * or holds its single writer. Conflicting accesses abort right away, so there
+ * is nothing left to validate on commit.
+**/
+template<class Locate> class Visible {
+public:
+    static constexpr bool per_word = Locate::per_word; // Whether records live in a per-word area
+protected:
+    static constexpr uint64_t writer = uint64_t{1} << 63;
+    static uint64_t owner(Transaction& tx) noexcept {
+        return writer | reinterpret_cast<uintptr_t>(&tx);
+    }
+public:
+    void begin(Transaction&) noexcept {}
+    /** Start reading a word guarded by the given record.
+     * @return 'false' on conflict, or else sample to pass to 'after'
+    **/
+    bool before(Transaction& tx, Record* record, uint64_t&) {
+        if (tx.is_ro) {
+            // Never upgraded, so counted again on every read rather than looked up
+            reserve_more(tx.counted);
+            auto value = record->load(::std::memory_order_acquire);
+            do {
+                if (value & writer)
+                    return false;
+            } while (!record->compare_exchange_weak(value, value + 1));
+            tx.counted.push_back(record);
+            return true;
+        }
+        if (tx.reads.contains(record))
+            return true;
+        tx.reads.reserve(); // Counted readers must be recorded to be released
+        auto value = record->load(::std::memory_order_acquire);
+        do {
+            if (value == owner(tx))
+                return true;
+            if (value & writer)
+                return false;
+        } while (!record->compare_exchange_weak(value, value + 1));
+        tx.reads.insert(record);
+        return true;
+    }
+    bool after(Transaction&, Record*, uint64_t) noexcept {
+        return true;
+    }
+    /** Whether the transaction holds the record for writing.
+    **/
+    bool owns(Transaction& tx, Record* record) noexcept {
+        return record->load(::std::memory_order_relaxed) == owner(tx);
+    }
+    /** Lock the given record for writing, upgrading our own read.
+    **/
+    bool lock(Transaction& tx, Record* record) {
+        auto value = record->load(::std::memory_order_acquire);
+        if (value == owner(tx))
+            return true;
+        uint64_t expected = tx.reads.contains(record) ? 1 : 0;
+        reserve_more(tx.locks); // Locks taken must be recorded to be released
+        if (value != expected || !record->compare_exchange_strong(value, owner(tx)))
+            return false;
+        tx.locks.emplace_back(record, expected);
+        return true;
+    }
+    bool validate(Transaction&) noexcept {
+        return true;
+    }
+    /** Release every record of the transaction.
+    **/
+    void release(Transaction& tx, bool) noexcept {
+        for (auto record: tx.counted)
+            record->fetch_sub(1, ::std::memory_order_release);
+        for (auto key: tx.reads.items()) {
+            auto record = reinterpret_cast<Record*>(key);
+            if (record->load(::std::memory_order_relaxed) != owner(tx)) // Upgraded reads are released along with the lock
+                record->fetch_sub(1, ::std::memory_order_release);
+        }
+        for (auto& [record, previous]: tx.locks)
+            record->store(0, ::std::memory_order_release);
+    }
+};
+
+/** Locates one record per word, in an area mirroring the data.
+**/
+struct WordRecords {
+    static constexpr bool per_word = true;
+};
+
+/** Locates records by hashing word addresses into a fixed table.
+**/
+template<unsigned Bits> struct StripeRecords {
+    static constexpr bool per_word = false;
+    static_assert(Bits > 0 && Bits < 32, "stripe tables hold between 2 and 2^31 records");
+    ::std::unique_ptr<Record[]> table{new Record[size_t{1} << Bits]()};
+    Record* locate(void const* address, size_t align) noexcept {
+        auto word = reinterpret_cast<uintptr_t>(address) / align;
+        return table.get() + ((word * 0x9e3779b97f4a7c15ul) >> (64 - Bits));
+    }
+};
+
+struct PerWord: Visible<WordRecords> {};
+
+template<unsigned Bits = 20> struct Striped: Visible<StripeRecords<Bits>> {
+    StripeRecords<Bits> stripes;
+    Record* locate(void const* address, size_t align) noexcept {
+        return stripes.locate(address, align);
+    }
+};
+
+/** Invisible reads: per-word versioned locks and a global version clock, as in
+ * TL2. Reads leave no trace in shared memory and are validated against the
+ * version clock, at once and on commit.
+**/
+class InvisibleReads {
+public:
+    static constexpr bool per_word = true;
+private:
+    ::std::atomic<uint64_t> clock{0}; // Even, locked records holding their odd owner
+    static uint64_t owner(Transaction& tx) noexcept {
+        return reinterpret_cast<uintptr_t>(&tx) | 1;
+    }
+public:
+    void begin(Transaction& tx) noexcept {
+        tx.rv = clock.load(::std::memory_order_acquire);
+    }
+    bool before(Transaction& tx, Record* record, uint64_t& sample) noexcept {
+        sample = record->load(::std::memory_order_acquire);
+        if (sample == owner(tx))
+            return true;
+        return !(sample & 1) && sample <= tx.rv;
+    }
+    bool after(Transaction& tx, Record* record, uint64_t sample) {
+        ::std::atomic_thread_fence(::std::memory_order_acquire);
+        if (record->load(::std::memory_order_relaxed) != sample)
+            return false;
+        if (!tx.is_ro && sample != owner(tx))
+            tx.reads.insert(record);
+        return true;
+    }
+    bool owns(Transaction& tx, Record* record) noexcept {
+        return record->load(::std::memory_order_relaxed) == owner(tx);
+    }
+    /** Lock the given record for writing. Records read and written since by
+     * others fail, as validation would: once locked, validation skips them.
+    **/
+    bool lock(Transaction& tx, Record* record) {
+        auto value = record->load(::std::memory_order_acquire);
+        if (value == owner(tx))
+            return true;
+        reserve_more(tx.locks); // Locks taken must be recorded to be released
+        if ((value & 1) || (value > tx.rv && tx.reads.contains(record)) || !record->compare_exchange_strong(value, owner(tx)))
+            return false;
+        tx.locks.emplace_back(record, value);
+        return true;
+    }
+    /** Take the write version and check that nothing read has changed since.
+    **/
+    bool validate(Transaction& tx) noexcept {
+        if (tx.locks.empty())
+            return true;
+        tx.wv = clock.fetch_add(2) + 2;
+        if (tx.wv == tx.rv + 2)
+            return true;
+        for (auto key: tx.reads.items()) {
+            auto value = reinterpret_cast<Record*>(key)->load(::std::memory_order_acquire);
+            if (value != owner(tx) && ((value & 1) || value > tx.rv))
+                return false;
+        }
+        return true;
+    }
+    /** Release every record of the transaction.
+     * @param committed Whether the records take the write version, or else their previous value
+     * @param dirty     Whether the data of aborted writes was changed in place, readers needing a new version
+    **/
+    void release(Transaction& tx, bool committed, bool dirty = false) noexcept {
+        uint64_t version = committed ? tx.wv : (dirty && !tx.locks.empty() ? clock.fetch_add(2) + 2 : 0);
+        for (auto& [record, previous]: tx.locks)
+            record->store(version != 0 ? version : previous, ::std::memory_order_release);
+    }
+};
+
+/** Value validation, as in NOrec: no metadata at all but one global sequence
+ * lock, odd while a transaction writes back. Reads are logged with their value
+ * and validated again whenever the sequence lock moved. Requires 'RedoLog'.
+**/
+class ValueValidation {
+public:
+    static constexpr bool per_word = false;
+private:
+    ::std::atomic<uint64_t> sequence{0};
+    uint64_t sample() noexcept {
+        auto time = sequence.load(::std::memory_order_acquire);
+        while (time & 1) {
+            Yield::relax(); // The writer may need our CPU to finish its write-back
+            time = sequence.load(::std::memory_order_acquire);
+        }
+        return time;
+    }
+    /** Check that every word read still holds the value seen, moving the
+     * snapshot of the transaction to the current sequence lock.
+    **/
+    bool revalidate(Transaction& tx) noexcept {
+        while (true) {
+            auto time = sample();
+            auto value = tx.logged_values.data();
+            for (auto [address, size]: tx.logged) {
+                if (::std::memcmp(reinterpret_cast<void*>(address), value, size) != 0)
+                    return false;
+                value += size;
+            }
+            ::std::atomic_thread_fence(::std::memory_order_acquire);
+            if (sequence.load(::std::memory_order_relaxed) == time) {
+                tx.rv = time;
+                return true;
+            }
+        }
+    }
+public:
+    void begin(Transaction& tx) noexcept {
+        tx.rv = sample();
+    }
+    /** Read a range of words consistent with all the previous reads, and log
+     * it as a whole, so that bulk reads cost one copy and one comparison each.
+    **/
+    bool read(Transaction& tx, void const* address, void* output, size_t size) {
+        ::std::memcpy(output, address, size);
+        ::std::atomic_thread_fence(::std::memory_order_acquire);
+        while (sequence.load(::std::memory_order_relaxed) != tx.rv) {
+            if (!revalidate(tx))
+                return false;
+            ::std::memcpy(output, address, size);
+            ::std::atomic_thread_fence(::std::memory_order_acquire);
+        }
+        // Value first, 'revalidate' only comparing the ranges logged
+        tx.logged_values.insert(tx.logged_values.end(), static_cast<char const*>(output), static_cast<char const*>(output) + size);
+        tx.logged.emplace_back(reinterpret_cast<uintptr_t>(address), size);
+        return true;
+    }
+    /** Take the sequence lock to write back, unless nothing changed.
+    **/
+    bool acquire(Transaction& tx) noexcept {
+        if (tx.redo.items().empty() && tx.frees.empty())
+            return true;
+        auto time = tx.rv;
+        while (!sequence.compare_exchange_strong(time, time + 1)) {
+            if (!revalidate(tx))
+                return false;
+            time = tx.rv;
+        }
+        tx.wv = time + 1;
+        return true;
+    }
+    void release(Transaction& tx, bool committed) noexcept {
+        if (committed && tx.wv != 0)
+            sequence.store(tx.wv + 1, ::std::memory_order_release);
+    }
+};
+
+// -------------------------------------------------------------------------- //
+// Admission policies
+
+/** Transactions enter at once. Freed segments are reused once the region
+ * is quiescent, i.e. once no transaction runs: every transaction that could
+ * still reach them has left by then.
+**/
+class NoAdmission {
+private:
+    ::std::atomic<uint64_t> running{0};
+    ::std::mutex retired_lock;
+    ::std::vector<void*> retired;
+public:
+    template<class Waiting> void enter(Transaction&, Waiting&) noexcept {
+        running.fetch_add(1);
+    }
+    template<class Waiting, class Reclaim> void leave(Transaction&, Waiting&, Reclaim&& reclaim) noexcept {
+        if (running.fetch_sub(1) != 1)
+            return;
+        ::std::vector<void*> segments;
+        {
+            // Segments retire while their transaction runs, so none can be missed here
+            ::std::lock_guard<::std::mutex> guard{retired_lock};
+            if (running.load() != 0)
+                return;
+            segments.swap(retired);
+        }
+        for (auto segment: segments)
+            reclaim(segment);
+    }
+    template<class Reclaim> void retire(void* segment, Reclaim&&) noexcept {
+        ::std::lock_guard<::std::mutex> guard{retired_lock};
+        try {
+            retired.push_back(segment);
+        } catch (::std::bad_alloc const&) {} // Leaked
+    }
+};
+
+/** Transactions enter in epochs through a ticket, at most 'Slots' read-write
+ * ones per epoch. The epoch ends when its last transaction leaves, the next
+ * ones waiting meanwhile. Freed segments are reused once their epoch ended.
+**/
+template<unsigned Slots = 16> class TicketBatcher {
+private:
+    ::std::atomic<uint64_t> turn{0};
+    ::std::atomic<uint64_t> last_turn{0};
+    ::std::atomic<uint32_t> epoch{0};
+    uint64_t n_entered = 0; // Only changed while holding the turn
+    uint64_t n_writers = 0;
+    bool closed = false;
+    ::std::mutex retired_lock;
+    ::std::vector<void*> retired;
+    template<class Waiting> void acquire(Waiting&) noexcept {
+        auto ticket = last_turn.fetch_add(1);
+        while (turn.load(::std::memory_order_acquire) != ticket)
+            Waiting::relax();
+    }
+    void release() noexcept {
+        turn.fetch_add(1, ::std::memory_order_release);
+    }
+public:
+    template<class Waiting> void enter(Transaction& tx, Waiting& waiting) {
+        while (true) {
+            acquire(waiting);
+            if (!closed && (tx.is_ro || n_writers < Slots)) {
+                ++n_entered;
+                if (!tx.is_ro && ++n_writers == Slots)
+                    closed = true; // Letting the epoch drain
+                release();
+                return;
+            }
+            auto current = epoch.load();
+            release();
+            waiting.wait(epoch, current);
+        }
+    }
+    template<class Waiting, class Reclaim> void leave(Transaction&, Waiting& waiting, Reclaim&& reclaim) noexcept {
+        acquire(waiting);
+        if (--n_entered == 0) {
+            // No transaction runs, segments freed in the epoch cannot be reached anymore
+            ::std::vector<void*> segments;
+            {
+                ::std::lock_guard<::std::mutex> guard{retired_lock};
+                segments.swap(retired);
+            }
+            for (auto segment: segments)
+                reclaim(segment);
+            n_writers = 0;
+            closed = false;
+            epoch.fetch_add(1);
+            waiting.wake(epoch);
+        }
+        release();
+    }
+    template<class Reclaim> void retire(void* segment, Reclaim&&) noexcept {
+        ::std::lock_guard<::std::mutex> guard{retired_lock};
+        try {
+            retired.push_back(segment);
+        } catch (::std::bad_alloc const&) {} // Leaked
+    }
+};
+
+/** Transactions announce the epoch they start in, in a slot of their thread,
+ * with no shared ticket. Freed segments are reused once every transaction that
+ * started before their free has left.
+**/
+class ScalableBatcher {
+private:
+    Announcements announcements;
+    ::std::atomic<uint64_t> epoch{1};
+    ::std::mutex retired_lock;
+    ::std::vector<::std::pair<uint64_t, void*>> retired;
+public:
+    template<class Waiting> void enter(Transaction&, Waiting&) noexcept {
+        announcements.announce(epoch);
+    }
+    template<class Waiting, class Reclaim> void leave(Transaction& tx, Waiting&, Reclaim&& reclaim) noexcept {
+        announcements.withdraw();
+        if (tx.frees.empty())
+            return;
+        // Segments freed before every running transaction started can be reused
+        auto oldest = announcements.minimum(epoch);
+        ::std::vector<void*> segments;
+        {
+            ::std::lock_guard<::std::mutex> guard{retired_lock};
+            try {
+                segments.reserve(retired.size());
+            } catch (::std::bad_alloc const&) {
+                return; // Reclaimed by a later transaction
+            }
+            for (size_t i = 0; i < retired.size();) {
+                if (retired[i].first < oldest) {
+                    segments.push_back(retired[i].second);
+                    retired[i] = retired.back();
+                    retired.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+        }
+        for (auto segment: segments)
+            reclaim(segment);
+    }
+    template<class Reclaim> void retire(void* segment, Reclaim&&) noexcept {
+        auto stamp = epoch.fetch_add(1);
+        ::std::lock_guard<::std::mutex> guard{retired_lock};
+        try {
+            retired.emplace_back(stamp, segment);
+        } catch (::std::bad_alloc const&) {} // Leaked
+    }
+};
+
+// -------------------------------------------------------------------------- //
+
+/** Engine assembled from one policy of each kind.
+ * @param Versioning Where uncommitted writes live
+ * @param Detection  How conflicts are detected
+ * @param Admission  How transactions are let in, and freed segments reclaimed
+ * @param Waiting    How threads wait for each other
+**/
+template<class Versioning, class Detection, class Admission, class Waiting> class Engine final {
+    static constexpr bool buffered = ::std::is_same_v<Versioning, RedoLog> || Versioning::chains; // Whether writes go to the redo log
+    static constexpr bool value_based = ::std::is_same_v<Detection, ValueValidation>;
+    static_assert(!value_based || ::std::is_same_v<Versioning, RedoLog>, "value validation needs writes buffered until commit");
+    static_assert(!Versioning::chains || ::std::is_same_v<Detection, InvisibleReads>, "version chains are ordered by write versions");
+private:
+    /** Header placed right before each segment.
+    **/
+    struct Header {
+        size_t size;
+    };
+    size_t align;
+    size_t header;    // Length of the header, keeping the segment aligned
+    size_t capacity;  // Length of the data area
+    size_t length;    // Length of the whole reservation
+    char* data;       // Data area, then shadow area, then per-word records, then per-word version chains
+    Record* records;  // Per-word records, when the detection policy uses them
+    void* chains;     // Per-word version chains, when the versioning policy keeps them
+    void* start;      // First segment
+    ::std::atomic<size_t> top{0};
+    ::std::mutex free_lock;
+    ::std::unordered_map<size_t, ::std::vector<char*>> free_blocks; // By segment size
+    Versioning versioning;
+    Detection detection;
+    Admission admission;
+    Waiting waiting;
+    static size_t records_offset(size_t capacity) noexcept {
+        return Versioning::shadow_area ? capacity << 1 : capacity;
+    }
+    static size_t chains_offset(size_t capacity, size_t align) noexcept {
+        return records_offset(capacity) + (Detection::per_word ? capacity / align * sizeof(Record) : 0);
+    }
+public:
+    Engine(size_t align, char* base, size_t capacity, size_t length) noexcept:
+        align{align}, header{align < sizeof(Header) ? sizeof(Header) : align}, capacity{capacity}, length{length}, data{base},
+        records{reinterpret_cast<Record*>(base + records_offset(capacity))}, chains{base + chains_offset(capacity, align)}, start{nullptr} {}
+    /** Create a region, with a first segment of the given size.
+     * @return Region, 'nullptr' on failure
+    **/
+    static Engine* create(size_t size, size_t align) noexcept {
+        auto capacity = size_t{TM_ENGINE_CAPACITY};
+        auto length = chains_offset(capacity, align) + (Versioning::chains ? capacity / align * sizeof(void*) : 0);
+        auto base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED)
+            return nullptr;
+        auto engine = new(::std::nothrow) Engine{align, static_cast<char*>(base), capacity, length};
+        if (!engine || !(engine->start = engine->allocate(size))) {
+            delete engine;
+            ::munmap(base, length);
+            return nullptr;
+        }
+        return engine;
+    }
+    ~Engine() noexcept {
+        if constexpr (Versioning::chains) {
+            ::std::vector<typename Versioning::Version*> versions;
+            auto used = ::std::min(top.load(), capacity);
+            for (size_t i = 0; i < used; i += align) {
+                versioning.forget(chain(data + i), versions);
+                for (auto version: versions)
+                    ::operator delete(version);
+                versions.clear();
+            }
+        }
+        ::munmap(data, length);
+    }
+    void* first() const noexcept {
+        return start;
+    }
+    size_t first_size() const noexcept {
+        return reinterpret_cast<Header*>(static_cast<char*>(start) - header)->size;
+    }
+    size_t alignment() const noexcept {
+        return align;
+    }
+private:
+    /** Carve a zeroed segment, reusing the blocks of reclaimed ones.
+    **/
+    void* allocate(size_t size) noexcept {
+        char* block = nullptr;
+        {
+            ::std::lock_guard<::std::mutex> guard{free_lock};
+            auto blocks = free_blocks.find(size);
+            if (blocks != free_blocks.end() && !blocks->second.empty()) {
+                block = blocks->second.back();
+                blocks->second.pop_back();
+            }
+        }
+        if (block) {
+            ::std::memset(block + header, 0, size);
+        } else {
+            // Only moving the top over blocks that fit, failed requests leaving room for others
+            auto offset = top.load();
+            do {
+                if (capacity - offset < header || capacity - offset - header < size)
+                    return nullptr;
+            } while (!top.compare_exchange_weak(offset, offset + header + size));
+            block = data + offset; // Fresh pages read as zeros
+        }
+        reinterpret_cast<Header*>(block)->size = size;
+        return block + header;
+    }
+    /** Give back a segment no transaction can reach anymore; without the
+     * memory to record it, it is leaked.
+    **/
+    void reclaim(void* segment) noexcept {
+        auto block = static_cast<char*>(segment) - header;
+        if constexpr (Versioning::chains) {
+            ::std::vector<typename Versioning::Version*> unlinked;
+            auto size = reinterpret_cast<Header*>(block)->size;
+            try {
+                for (size_t i = 0; i < size; i += align)
+                    versioning.forget(chain(static_cast<char*>(segment) + i), unlinked);
+            } catch (::std::bad_alloc const&) {} // Versions not recorded are leaked
+            versioning.retire(unlinked);
+        }
+        ::std::lock_guard<::std::mutex> guard{free_lock};
+        try {
+            free_blocks[reinterpret_cast<Header*>(block)->size].push_back(block);
+        } catch (::std::bad_alloc const&) {}
+    }
+    Record* record(void const* address) noexcept {
+        if constexpr (Detection::per_word) {
+            return records + (static_cast<char const*>(address) - data) / align;
+        } else {
+            return detection.locate(address, align);
+        }
+    }
+    auto& chain(void const* address) noexcept {
+        return static_cast<typename Versioning::Chain*>(chains)[(static_cast<char const*>(address) - data) / align];
+    }
+    void* shadow(void const* address) noexcept {
+        return const_cast<char*>(static_cast<char const*>(address)) + capacity;
+    }
+    /** Lock every word of a segment to free, so nobody else accesses it until the commit.
+    **/
+    bool lock_segment(Transaction& tx, void* segment) {
+        auto size = reinterpret_cast<Header*>(static_cast<char*>(segment) - header)->size;
+        for (size_t i = 0; i < size; i += align) {
+            if (!detection.lock(tx, record(static_cast<char*>(segment) + i)))
+                return false;
+        }
+        return true;
+    }
+    void finish(Transaction& tx) noexcept {
+        if constexpr (Versioning::chains) {
+            if (tx.is_ro)
+                versioning.leave(tx);
+        }
+        admission.leave(tx, waiting, [this](void* segment) { reclaim(segment); });
+    }
+public:
+    /** Begin a transaction.
+    **/
+    Transaction* begin(bool is_ro) noexcept {
+        auto& spare = this->spare();
+        Transaction* tx;
+        try {
+            tx = spare ? spare.release() : new Transaction{};
+        } catch (::std::bad_alloc const&) {
+            return nullptr;
+        }
+        tx->reset(is_ro);
+        admission.enter(*tx, waiting);
+        detection.begin(*tx);
+        if constexpr (Versioning::chains) {
+            if (is_ro)
+                versioning.enter(*tx);
+        }
+        return tx;
+    }
+    /** Abort the given transaction, which ends it.
+    **/
+    void abort(Transaction* tx) noexcept {
+        if constexpr (Versioning::in_place) {
+            for (size_t i = tx->undo.size(); i-- > 0;)
+                ::std::memcpy(reinterpret_cast<void*>(tx->undo[i]), tx->undo_values.data() + i * align, align);
+        }
+        if constexpr (::std::is_same_v<Detection, InvisibleReads>) {
+            detection.release(*tx, false, Versioning::in_place);
+        } else {
+            detection.release(*tx, false);
+        }
+        if constexpr (Versioning::chains) {
+            if (tx->wv != 0) // Taken by a failed validation, later ones waiting for it
+                versioning.template publish<Waiting>(tx->wv);
+        }
+        // Segments allocated were never seen by anyone else
+        for (auto segment: tx->allocs)
+            reclaim(segment);
+        finish(*tx);
+        recycle(tx);
+        // Back off before the retry, letting the transaction we conflicted with finish
+        Waiting::relax();
+    }
+    /** Try to commit the given transaction, which ends it.
+    **/
+    bool commit(Transaction* tx) noexcept {
+        try {
+            if (!acquire(tx))
+                return false;
+        } catch (::std::bad_alloc const&) {
+            abort(tx);
+            return false;
+        }
+        if constexpr (::std::is_same_v<Versioning, Shadow>) {
+            for (auto key: tx->written.items())
+                ::std::memcpy(reinterpret_cast<void*>(key), shadow(reinterpret_cast<void*>(key)), align);
+        } else if constexpr (buffered) {
+            auto const& keys = tx->redo.items();
+            if constexpr (Versioning::chains) {
+                // Versions go in the chains before the data, read-only transactions only reading the former
+                ::std::vector<typename Versioning::Version*> nodes;
+                ::std::vector<typename Versioning::Version*> unlinked;
+                if (!versioning.prepare(keys.size(), align, nodes, unlinked)) {
+                    abort(tx);
+                    return false;
+                }
+                auto floor = versioning.floor();
+                for (size_t i = 0; i < keys.size(); ++i)
+                    versioning.install(chain(reinterpret_cast<void*>(keys[i])), nodes[i], tx->redo.value(i, align), align, tx->wv, floor, unlinked);
+                for (size_t i = 0; i < keys.size(); ++i)
+                    ::std::memcpy(reinterpret_cast<void*>(keys[i]), tx->redo.value(i, align), align);
+                detection.release(*tx, true);
+                if (tx->wv != 0)
+                    versioning.template publish<Waiting>(tx->wv);
+                versioning.retire(unlinked);
+            } else {
+                for (size_t i = 0; i < keys.size(); ++i)
+                    ::std::memcpy(reinterpret_cast<void*>(keys[i]), tx->redo.value(i, align), align);
+            }
+        }
+        if constexpr (!Versioning::chains)
+            detection.release(*tx, true);
+        for (auto segment: tx->frees)
+            admission.retire(segment, [this](void* segment) { reclaim(segment); });
+        finish(*tx);
+        recycle(tx);
+        return true;
+    }
+    /** Transactional read of whole words, aborting on failure.
+    **/
+    bool read(Transaction* tx, void const* source, size_t size, void* target) noexcept {
+        try {
+            return read_words(tx, source, size, target);
+        } catch (::std::bad_alloc const&) {
+            abort(tx);
+            return false;
+        }
+    }
+    /** Transactional write of whole words, aborting on failure.
+    **/
+    bool write(Transaction* tx, void const* source, size_t size, void* target) noexcept {
+        try {
+            return write_words(tx, source, size, target);
+        } catch (::std::bad_alloc const&) {
+            abort(tx);
+            return false;
+        }
+    }
+    Alloc alloc(Transaction* tx, size_t size, void** target) noexcept {
+        auto segment = allocate(size);
+        if (!segment)
+            return Alloc::nomem;
+        try {
+            tx->allocs.push_back(segment);
+        } catch (::std::bad_alloc const&) {
+            reclaim(segment);
+            return Alloc::nomem;
+        }
+        *target = segment;
+        return Alloc::success;
+    }
+    bool free(Transaction* tx, void* segment) noexcept {
+        try {
+            if constexpr (Versioning::eager) {
+                if (!lock_segment(*tx, segment)) {
+                    abort(tx);
+                    return false;
+                }
+            }
+            tx->frees.push_back(segment);
+        } catch (::std::bad_alloc const&) {
+            abort(tx);
+            return false;
+        }
+        return true;
+    }
+private:
+    /** Lock and validate what the given transaction commits, aborting on failure.
+    **/
+    bool acquire(Transaction* tx) {
+        if constexpr (value_based) {
+            if (!detection.acquire(*tx)) {
+                abort(tx);
+                return false;
+            }
+        } else if constexpr (!Versioning::eager) {
+            for (auto key: tx->redo.items()) {
+                if (!detection.lock(*tx, record(reinterpret_cast<void*>(key)))) {
+                    abort(tx);
+                    return false;
+                }
+            }
+            for (auto segment: tx->frees) {
+                if (!lock_segment(*tx, segment)) {
+                    abort(tx);
+                    return false;
+                }
+            }
+        }
+        if constexpr (!value_based) {
+            if (!detection.validate(*tx)) {
+                abort(tx);
+                return false;
+            }
+        }
+        return true;
+    }
+    bool read_words(Transaction* tx, void const* source, size_t size, void* target) {
+        if constexpr (value_based) {
+            // The whole range at once, then our own writes over it
+            if (!detection.read(*tx, source, target, size)) {
+                abort(tx);
+                return false;
+            }
+            if (!tx->is_ro && !tx->redo.items().empty()) {
+                for (size_t i = 0; i < size; i += align) {
+                    if (auto value = tx->redo.find(static_cast<char const*>(source) + i, align))
+                        ::std::memcpy(static_cast<char*>(target) + i, value, align);
+                }
+            }
+            return true;
+        } else {
+            for (size_t i = 0; i < size; i += align) {
+                auto address = static_cast<char const*>(source) + i;
+                auto output = static_cast<char*>(target) + i;
+                // Snapshot of read-only transactions
+                if constexpr (Versioning::chains) {
+                    if (tx->is_ro) {
+                        if (!versioning.read(*tx, chain(address), output, align)) {
+                            abort(tx);
+                            return false;
+                        }
+                        continue;
+                    }
+                }
+                // Our own writes
+                if constexpr (::std::is_same_v<Versioning, Shadow>) {
+                    if (!tx->is_ro && tx->written.contains(address)) {
+                        ::std::memcpy(output, shadow(address), align);
+                        continue;
+                    }
+                } else if constexpr (buffered) {
+                    if (!tx->is_ro) {
+                        if (auto value = tx->redo.find(address, align)) {
+                            ::std::memcpy(output, value, align);
+                            continue;
+                        }
+                    }
+                }
+                auto guard = record(address);
+                uint64_t sample = 0;
+                if (!detection.before(*tx, guard, sample)) {
+                    abort(tx);
+                    return false;
+                }
+                ::std::memcpy(output, address, align);
+                if (!detection.after(*tx, guard, sample)) {
+                    abort(tx);
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+    bool write_words(Transaction* tx, void const* source, size_t size, void* target) {
+        for (size_t i = 0; i < size; i += align) {
+            auto address = static_cast<char*>(target) + i;
+            auto input = static_cast<char const*>(source) + i;
+            if constexpr (Versioning::eager) {
+                if (!detection.lock(*tx, record(address))) {
+                    abort(tx);
+                    return false;
+                }
+            }
+            if constexpr (::std::is_same_v<Versioning, Shadow>) {
+                tx->written.insert(address);
+                ::std::memcpy(shadow(address), input, align);
+            } else if constexpr (buffered) {
+                tx->redo.put(address, input, align);
+            } else {
+                if (tx->written.insert(address)) {
+                    // Previous value first, an abort only restoring the words logged
+                    tx->undo_values.insert(tx->undo_values.end(), address, address + align);
+                    tx->undo.push_back(reinterpret_cast<uintptr_t>(address));
+                }
+                ::std::memcpy(address, input, align);
+            }
+        }
+        return true;
+    }
+    /** Descriptor kept by the calling thread for its next transaction.
+    **/
+    static ::std::unique_ptr<Transaction>& spare() noexcept {
+        thread_local ::std::unique_ptr<Transaction> spare;
+        return spare;
+    }
+    static void recycle(Transaction* tx) noexcept {
+        auto& spare = Engine::spare();
+        if (spare)
+            delete tx;
+        else
+            spare.reset(tx);
+    }
+};
+
+/** Backend of 'tm_api.hpp' calling an engine compiled in the same program,
+ * so that accesses through 'stm::ref'/'stm::span' inline completely.
+ * @param Engine Instantiation of 'Engine'
+**/
+template<class Engine> struct Direct {
+    using handle = Engine*;
+    using tx = Transaction*;
+    static constexpr handle invalid_handle = nullptr;
+    static constexpr tx invalid_tx = nullptr;
+    static handle create(size_t size, size_t align) noexcept {
+        return Engine::create(size, align);
+    }
+    static void destroy(handle region) noexcept {
+        delete region;
+    }
+    static void* start(handle region) noexcept {
+        return region->first();
+    }
+    static size_t size(handle region) noexcept {
+        return region->first_size();
+    }
+    static size_t align(handle region) noexcept {
+        return region->alignment();
+    }
+    static tx begin(handle region, bool is_ro) noexcept {
+        return region->begin(is_ro);
+    }
+    static bool end(handle region, tx id) noexcept {
+        return region->commit(id);
+    }
+    static bool read(handle region, tx id, void const* source, size_t size, void* target) noexcept {
+        return region->read(id, source, size, target);
+    }
+    static bool write(handle region, tx id, void const* source, size_t size, void* target) noexcept {
+        return region->write(id, source, size, target);
+    }
+    static Alloc alloc(handle region, tx id, size_t size, void** target) noexcept {
+        return region->alloc(id, size, target);
+    }
+    static bool free(handle region, tx id, void* segment) noexcept {
+        return region->free(id, segment);
+    }
+};
+
+}
+
+// -------------------------------------------------------------------------- //
+
+/** Export the interface of 'tm.hpp' from the given engine.
+ * @param ... Instantiation of 'tm_engine::Engine'
+**/
+#define TM_ENGINE_EXPORT(...) \
+    using TmEngine = __VA_ARGS__; \
+    shared_t tm_create(size_t size, size_t align) noexcept { \
+        auto engine = TmEngine::create(size, align); \
+        return engine ? static_cast<shared_t>(engine) : invalid_shared; \
+    } \
+    void tm_destroy(shared_t shared) noexcept { delete static_cast<TmEngine*>(shared); } \
+    void* tm_start(shared_t shared) noexcept { return static_cast<TmEngine*>(shared)->first(); } \
+    size_t tm_size(shared_t shared) noexcept { return static_cast<TmEngine*>(shared)->first_size(); } \
+    size_t tm_align(shared_t shared) noexcept { return static_cast<TmEngine*>(shared)->alignment(); } \
+    tx_t tm_begin(shared_t shared, bool is_ro) noexcept { \
+        auto tx = static_cast<TmEngine*>(shared)->begin(is_ro); \
+        return tx ? reinterpret_cast<tx_t>(tx) : invalid_tx; \
+    } \
+    bool tm_end(shared_t shared, tx_t tx) noexcept { return static_cast<TmEngine*>(shared)->commit(reinterpret_cast<::tm_engine::Transaction*>(tx)); } \
+    bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept { return static_cast<TmEngine*>(shared)->read(reinterpret_cast<::tm_engine::Transaction*>(tx), source, size, target); } \
+    bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) noexcept { return static_cast<TmEngine*>(shared)->write(reinterpret_cast<::tm_engine::Transaction*>(tx), source, size, target); } \
+    Alloc tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) noexcept { return static_cast<TmEngine*>(shared)->alloc(reinterpret_cast<::tm_engine::Transaction*>(tx), size, target); } \
+    bool tm_free(shared_t shared, tx_t tx, void* segment) noexcept { return static_cast<TmEngine*>(shared)->free(reinterpret_cast<::tm_engine::Transaction*>(tx), segment); }
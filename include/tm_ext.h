@@ -0,0 +1,80 @@
+/**
+ * @file   tm_ext.h
+ *
+ * @section DESCRIPTION
+ *
+ * Interface declaration for the extensions provided by the batcher-based
+ * transaction manager in 'src/' (C version). These are optional: libraries
+ * only implementing 'tm.h' remain fully usable by the grading program.
+ **/
+
+#pragma once
+
+#include <sys/types.h>
+#include <tm.h>
+
+// -------------------------------------------------------------------------- //
+
+// Body of one transaction submitted through 'tm_run_batch'. It must only use
+// the given transaction with tm_read/tm_write/tm_alloc/tm_free, and never call
+// tm_begin/tm_end itself. It returns whether the body ran to completion, i.e.
+// 'false' as soon as one tm_* operation reported an abort. Bodies that do not
+// complete are run again on the next admission of the batch, up to 16
+// admissions in all: those still not completing are then reported as not
+// committed, and are for the caller to submit again.
+typedef bool (*tm_batch_fn)(shared_t, tx_t, void *);
+
+// Contiguous range of shared memory, 'size' bytes long from 'start'.
+typedef struct
+{
+    void *start;
+    size_t size;
+} tm_range_t;
+
+// Header of one record of the change feed, see 'tm_feed_start'. It is
+// followed by the 'size' bytes written, padded to a multiple of 8 bytes.
+typedef struct
+{
+    unsigned long epoch; // Epoch that committed the bytes, see 'tm_epoch'
+    void *segment;       // First byte of the segment written
+    size_t offset;       // Offset of the bytes in the segment
+    size_t size;         // Number of bytes
+} tm_change_t;
+
+// Continuation of a transaction waiting for an epoch, see 'tm_begin_async'.
+// It must stay valid until called, which happens on the thread committing the
+// epoch while it still holds the batcher: 'resume' must only hand 'arg' over
+// to some executor, and never call the transaction manager itself.
+typedef struct tm_resume
+{
+    void (*resume)(void *); // Called once the epoch waited for is over
+    void *arg;              // Argument of 'resume'
+    struct tm_resume *next; // Next continuation waiting, set by the region
+} tm_resume_t;
+
+// Statistics about one shared memory region, see 'tm_stats'.
+typedef struct
+{
+    size_t mapped_bytes; // Bytes of data, shadow and control words backed by mmap
+    size_t huge_bytes;   // Bytes of those currently backed by huge pages
+    size_t shadow_bytes; // Bytes of shadow copies and control words not reclaimed
+} tm_stats_t;
+
+// -------------------------------------------------------------------------- //
+
+shared_t tm_create_file(char const *, size_t, size_t);
+shared_t tm_create_durable(char const *, char const *, size_t, size_t);
+shared_t tm_create_shared(char const *, size_t, size_t);
+bool tm_checkpoint(shared_t, char const *);
+bool tm_coordinate(shared_t, bool);
+unsigned long tm_epoch(shared_t);
+unsigned long tm_modified(shared_t, void const *, size_t);
+bool tm_feed_start(shared_t, size_t, int);
+ssize_t tm_feed_read(shared_t, unsigned long long *, void *, size_t);
+bool tm_wait_change(shared_t, tx_t, void const *, size_t);
+void tm_stats(shared_t, tm_stats_t *);
+tx_t tm_begin_declared(shared_t, tm_range_t const *, size_t);
+tx_t tm_begin_domains(shared_t, bool, unsigned int);
+tx_t tm_begin_async(shared_t, bool, tm_resume_t *);
+bool tm_end_async(shared_t, tx_t, tm_resume_t *);
+size_t tm_run_batch(shared_t, size_t, tm_batch_fn const *, void *const *, bool *);
@@ -0,0 +1,18 @@
+/**
+ * @file   tm.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Multi-version transaction manager, built from 'tm_engine.hpp': read-write
+ * transactions run as in 'tl2/', and every word also keeps a bounded chain of
+ * its committed versions. Read-only transactions read the snapshot of their
+ * start from the chains, so long scans never wait for writers nor hold them
+ * back. Versions no snapshot needs are dropped, and freed by epoch.
+**/
+
+// Internal headers
+#include <tm_engine.hpp>
+
+// -------------------------------------------------------------------------- //
+
+TM_ENGINE_EXPORT(::tm_engine::Engine<::tm_engine::MultiVersion<8>, ::tm_engine::InvisibleReads, ::tm_engine::ScalableBatcher, ::tm_engine::Yield>)
@@ -0,0 +1,17 @@
+/**
+ * @file   tm.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction manager in the style of NOrec, built from 'tm_engine.hpp': one
+ * global sequence lock and no per-word metadata. Reads are validated by value
+ * whenever a writer committed since, and writes are buffered then written back
+ * while holding the sequence lock. Suited to regions with few writes.
+**/
+
+// Internal headers
+#include <tm_engine.hpp>
+
+// -------------------------------------------------------------------------- //
+
+TM_ENGINE_EXPORT(::tm_engine::Engine<::tm_engine::RedoLog, ::tm_engine::ValueValidation, ::tm_engine::ScalableBatcher, ::tm_engine::Yield>)
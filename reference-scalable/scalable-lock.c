@@ -0,0 +1,49 @@
+#include "scalable-lock.h"
+
+#include <sched.h>
+
+bool scalable_lock_init(struct scalable_lock_t* lock) {
+    if (pthread_mutex_init(&lock->writers, NULL) != 0)
+        return false;
+    atomic_init(&lock->writing, false);
+    for (size_t i = 0; i < SCALABLE_LOCK_SLOTS; ++i)
+        atomic_init(&lock->readers[i].count, 0);
+    return true;
+}
+
+void scalable_lock_cleanup(struct scalable_lock_t* lock) {
+    pthread_mutex_destroy(&lock->writers);
+}
+
+bool scalable_lock_acquire(struct scalable_lock_t* lock) {
+    if (pthread_mutex_lock(&lock->writers) != 0)
+        return false;
+    atomic_store(&lock->writing, true);
+    for (size_t i = 0; i < SCALABLE_LOCK_SLOTS; ++i) {
+        while (atomic_load(&lock->readers[i].count) != 0)
+            sched_yield();
+    }
+    return true;
+}
+
+void scalable_lock_release(struct scalable_lock_t* lock) {
+    atomic_store(&lock->writing, false);
+    pthread_mutex_unlock(&lock->writers);
+}
+
+size_t scalable_lock_acquire_shared(struct scalable_lock_t* lock) {
+    int cpu = sched_getcpu();
+    size_t slot = cpu < 0 ? 0 : (size_t) cpu % SCALABLE_LOCK_SLOTS;
+    while (true) {
+        atomic_fetch_add(&lock->readers[slot].count, 1);
+        if (!atomic_load(&lock->writing))
+            return slot;
+        atomic_fetch_sub(&lock->readers[slot].count, 1);
+        while (atomic_load(&lock->writing))
+            sched_yield();
+    }
+}
+
+void scalable_lock_release_shared(struct scalable_lock_t* lock, size_t slot) {
+    atomic_fetch_sub_explicit(&lock->readers[slot].count, 1, memory_order_release);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// Requested feature: sched_getcpu
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Number of reader counters, readers using the one of the CPU they run on.
+**/
+#ifndef SCALABLE_LOCK_SLOTS
+#define SCALABLE_LOCK_SLOTS 64
+#endif
+
+/**
+ * @brief Counter of the readers of one CPU, alone on its cache line.
+ */
+struct reader_slot_t {
+    _Alignas(64) atomic_ulong count;
+};
+
+/**
+ * @brief A lock that can be taken exclusively but also shared. Readers only
+ * touch the counter of their CPU, so they do not contend with each other; a
+ * writer announces itself then waits for every counter to drop to zero.
+ * Writers are preferred: readers back off while one is announced.
+ */
+struct scalable_lock_t {
+    pthread_mutex_t writers; // Serializes writers
+    atomic_bool writing;     // Whether a writer holds or awaits the lock
+    struct reader_slot_t readers[SCALABLE_LOCK_SLOTS];
+};
+
+/** Initialize the given lock.
+ * @param lock Lock to initialize
+ * @return Whether the operation is a success
+**/
+bool scalable_lock_init(struct scalable_lock_t* lock);
+
+/** Clean the given lock up.
+ * @param lock Lock to clean up
+**/
+void scalable_lock_cleanup(struct scalable_lock_t* lock);
+
+/** Wait and acquire the given lock exclusively.
+ * @param lock Lock to acquire
+ * @return Whether the operation is a success
+**/
+bool scalable_lock_acquire(struct scalable_lock_t* lock);
+
+/** Release the given lock that has been taken exclusively.
+ * @param lock Lock to release
+**/
+void scalable_lock_release(struct scalable_lock_t* lock);
+
+/** Wait and acquire the given lock non-exclusively.
+ * @param lock Lock to acquire
+ * @return Reader counter to give back on release
+**/
+size_t scalable_lock_acquire_shared(struct scalable_lock_t* lock);
+
+/** Release the given lock that has been taken non-exclusively.
+ * @param lock Lock to release
+ * @param slot Reader counter returned on acquisition
+**/
+void scalable_lock_release_shared(struct scalable_lock_t* lock, size_t slot);
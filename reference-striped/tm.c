@@ -0,0 +1,363 @@
+/**
+ * @file   tm.c
+ *
+ * @section DESCRIPTION
+ *
+ * Lock-based transaction manager with one reader-writer lock per stripe of
+ * words, keyed by address, as a stronger reference than the single lock of
+ * 'reference/'. Transactions lock the stripes they access as they go (shared
+ * when read-only, exclusive otherwise) and keep them until they end, writing
+ * in place with an undo log. A lock that stays busy aborts the transaction,
+ * which can thus never deadlock.
+**/
+
+// Requested feature: posix_memalign
+#define _POSIX_C_SOURCE   200809L
+
+// External headers
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internal headers
+#include <tm.h>
+
+#include "macros.h"
+#include "shared-lock.h"
+
+/** Number of stripes, each word using the one of its address.
+**/
+#ifndef STRIPES
+#define STRIPES 4096
+#endif
+
+/** Number of times a busy stripe is tried again before aborting.
+**/
+#ifndef LOCK_ATTEMPTS
+#define LOCK_ATTEMPTS 16
+#endif
+
+/**
+ * @brief List of dynamically allocated segments.
+ */
+struct segment_node {
+    struct segment_node* prev;
+    struct segment_node* next;
+    // uint8_t segment[] // segment of dynamic size
+};
+typedef struct segment_node* segment_list;
+
+/**
+ * @brief Simple Shared Memory Region (a.k.a Transactional Memory).
+ */
+struct region {
+    struct shared_lock_t stripes[STRIPES]; // Lock of each stripe of words
+    pthread_mutex_t allocs_lock; // Guards the list of segments
+    void* start;        // Start of the shared memory region (i.e., of the non-deallocable memory segment)
+    segment_list allocs; // Shared memory segments dynamically allocated via tm_alloc within transactions
+    size_t size;        // Size of the non-deallocable memory segment (in bytes)
+    size_t align;       // Size of a word in the shared memory region (in bytes)
+};
+
+/**
+ * @brief Running transaction, the stripes it holds and how to undo it.
+ */
+struct transaction {
+    bool is_ro;
+    unsigned char held[STRIPES / 8]; // Bitmap of the stripes held
+    size_t* stripes;    // Stripes held, in acquisition order
+    size_t n_stripes;
+    size_t cap_stripes;
+    char* undo;         // Address then previous value of each word written
+    size_t n_undo;
+    size_t cap_undo;
+    void** allocs;      // Segments allocated
+    size_t n_allocs;
+    size_t cap_allocs;
+    void** frees;       // Segments to free on commit
+    size_t n_frees;
+    size_t cap_frees;
+};
+
+/** Maximum number of times, as a power of two, a thread yields before
+ * retrying after consecutive aborts.
+**/
+#ifndef BACKOFF_BITS
+#define BACKOFF_BITS 10
+#endif
+
+static _Thread_local struct transaction* spare_tx = NULL; // Kept by each thread for its next transaction
+static _Thread_local unsigned int n_aborts = 0;           // Consecutive aborts of the thread
+static _Thread_local uint32_t backoff_seed = 0;           // State of the generator of backoff lengths
+
+/** Grow a dynamic array so that it holds at least the given number of elements.
+ * @param array Array to grow
+ * @param cap   Capacity of the array (in elements)
+ * @param need  Number of elements needed
+ * @param elem  Size of one element (in bytes)
+ * @return Whether the operation is a success
+**/
+static bool reserve(void* array, size_t* cap, size_t need, size_t elem) {
+    if (likely(need <= *cap))
+        return true;
+    size_t capacity = *cap ? *cap : 16;
+    while (capacity < need)
+        capacity <<= 1;
+    void* grown = realloc(*(void**) array, capacity * elem);
+    if (unlikely(!grown))
+        return false;
+    *(void**) array = grown;
+    *cap = capacity;
+    return true;
+}
+
+/** Unlink a segment from the list of the region and free it.
+**/
+static void free_segment(struct region* region, void* segment) {
+    struct segment_node* sn = (struct segment_node*) ((uintptr_t) segment - sizeof(struct segment_node));
+    pthread_mutex_lock(&(region->allocs_lock));
+    if (sn->prev) sn->prev->next = sn->next;
+    else region->allocs = sn->next;
+    if (sn->next) sn->next->prev = sn->prev;
+    pthread_mutex_unlock(&(region->allocs_lock));
+    free(sn);
+}
+
+/** Release every stripe held by the transaction and keep it for the next one.
+**/
+static void end(struct region* region, struct transaction* tx) {
+    for (size_t i = 0; i < tx->n_stripes; ++i) {
+        size_t stripe = tx->stripes[i];
+        if (tx->is_ro) {
+            shared_lock_release_shared(&(region->stripes[stripe]));
+        } else {
+            shared_lock_release(&(region->stripes[stripe]));
+        }
+        tx->held[stripe / 8] = 0;
+    }
+    if (spare_tx) {
+        free(tx->stripes);
+        free(tx->undo);
+        free(tx->allocs);
+        free(tx->frees);
+        free(tx);
+    } else {
+        spare_tx = tx;
+    }
+}
+
+/** Roll the transaction back and end it.
+**/
+static void abort_tx(struct region* region, struct transaction* tx) {
+    size_t entry = sizeof(void*) + region->align;
+    for (size_t i = tx->n_undo; i-- > 0;) {
+        void* address;
+        memcpy(&address, tx->undo + i * entry, sizeof(void*));
+        memcpy(address, tx->undo + i * entry + sizeof(void*), region->align);
+    }
+    for (size_t i = 0; i < tx->n_allocs; ++i)
+        free_segment(region, tx->allocs[i]);
+    end(region, tx);
+    ++n_aborts;
+}
+
+/** Yield for a random time growing with the consecutive aborts of the thread,
+ * so that transactions aborting each other do not retry in lockstep.
+**/
+static void backoff() {
+    if (likely(n_aborts == 0))
+        return;
+    if (unlikely(backoff_seed == 0))
+        backoff_seed = (uint32_t) (uintptr_t) &backoff_seed | 1;
+    backoff_seed ^= backoff_seed << 13; // xorshift32
+    backoff_seed ^= backoff_seed >> 17;
+    backoff_seed ^= backoff_seed << 5;
+    unsigned int bits = n_aborts < BACKOFF_BITS ? n_aborts : BACKOFF_BITS;
+    for (uint32_t i = backoff_seed & ((UINT32_C(1) << bits) - 1); i > 0; --i)
+        sched_yield();
+}
+
+/** Lock the stripe of a word for the transaction, unless already held.
+ * @return Whether the stripe is held
+**/
+static bool acquire(struct region* region, struct transaction* tx, void const* address) {
+    size_t stripe = ((uintptr_t) address / region->align) % STRIPES;
+    if (tx->held[stripe / 8] & (1 << (stripe % 8)))
+        return true;
+    if (unlikely(!reserve(&(tx->stripes), &(tx->cap_stripes), tx->n_stripes + 1, sizeof(size_t))))
+        return false;
+    for (int attempt = 0;; ++attempt) {
+        bool acquired = tx->is_ro ? shared_lock_try_acquire_shared(&(region->stripes[stripe])) : shared_lock_try_acquire(&(region->stripes[stripe]));
+        if (likely(acquired))
+            break;
+        if (attempt == LOCK_ATTEMPTS)
+            return false;
+        sched_yield();
+    }
+    tx->held[stripe / 8] |= 1 << (stripe % 8);
+    tx->stripes[tx->n_stripes++] = stripe;
+    return true;
+}
+
+shared_t tm_create(size_t size, size_t align) {
+    struct region* region = (struct region*) malloc(sizeof(struct region));
+    if (unlikely(!region)) {
+        return invalid_shared;
+    }
+    // We allocate the shared memory buffer such that its words are correctly
+    // aligned.
+    if (posix_memalign(&(region->start), align, size) != 0) {
+        free(region);
+        return invalid_shared;
+    }
+    for (size_t i = 0; i < STRIPES; ++i) {
+        if (!shared_lock_init(&(region->stripes[i]))) {
+            while (i-- > 0)
+                shared_lock_cleanup(&(region->stripes[i]));
+            free(region->start);
+            free(region);
+            return invalid_shared;
+        }
+    }
+    pthread_mutex_init(&(region->allocs_lock), NULL);
+    memset(region->start, 0, size);
+    region->allocs      = NULL;
+    region->size        = size;
+    region->align       = align;
+    return region;
+}
+
+void tm_destroy(shared_t shared) {
+    struct region* region = (struct region*) shared;
+    while (region->allocs) { // Free allocated segments
+        segment_list tail = region->allocs->next;
+        free(region->allocs);
+        region->allocs = tail;
+    }
+    free(region->start);
+    for (size_t i = 0; i < STRIPES; ++i)
+        shared_lock_cleanup(&(region->stripes[i]));
+    pthread_mutex_destroy(&(region->allocs_lock));
+    free(region);
+}
+
+void* tm_start(shared_t shared) {
+    return ((struct region*) shared)->start;
+}
+
+size_t tm_size(shared_t shared) {
+    return ((struct region*) shared)->size;
+}
+
+size_t tm_align(shared_t shared) {
+    return ((struct region*) shared)->align;
+}
+
+tx_t tm_begin(shared_t unused(shared), bool is_ro) {
+    backoff();
+    struct transaction* tx = spare_tx;
+    if (tx) {
+        spare_tx = NULL;
+    } else {
+        tx = (struct transaction*) calloc(1, sizeof(struct transaction));
+        if (unlikely(!tx))
+            return invalid_tx;
+    }
+    tx->is_ro     = is_ro;
+    tx->n_stripes = 0;
+    tx->n_undo    = 0;
+    tx->n_allocs  = 0;
+    tx->n_frees   = 0;
+    return (tx_t) tx;
+}
+
+bool tm_end(shared_t shared, tx_t tx) {
+    struct region* region = (struct region*) shared;
+    struct transaction* transaction = (struct transaction*) tx;
+    // The segments freed are locked, nobody else can still reach them
+    for (size_t i = 0; i < transaction->n_frees; ++i)
+        free_segment(region, transaction->frees[i]);
+    end(region, transaction);
+    n_aborts = 0;
+    return true;
+}
+
+bool tm_read(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    struct transaction* transaction = (struct transaction*) tx;
+    for (size_t i = 0; i < size; i += region->align) {
+        if (unlikely(!acquire(region, transaction, (char const*) source + i))) {
+            abort_tx(region, transaction);
+            return false;
+        }
+    }
+    memcpy(target, source, size);
+    return true;
+}
+
+bool tm_write(shared_t shared, tx_t tx, void const* source, size_t size, void* target) {
+    struct region* region = (struct region*) shared;
+    struct transaction* transaction = (struct transaction*) tx;
+    size_t entry = sizeof(void*) + region->align;
+    if (unlikely(!reserve(&(transaction->undo), &(transaction->cap_undo), (transaction->n_undo + size / region->align) * entry, 1))) {
+        abort_tx(region, transaction);
+        return false;
+    }
+    for (size_t i = 0; i < size; i += region->align) {
+        char* address = (char*) target + i;
+        if (unlikely(!acquire(region, transaction, address))) {
+            abort_tx(region, transaction);
+            return false;
+        }
+        char* record = transaction->undo + transaction->n_undo++ * entry;
+        memcpy(record, &address, sizeof(void*));
+        memcpy(record + sizeof(void*), address, region->align);
+    }
+    memcpy(target, source, size);
+    return true;
+}
+
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void** target) {
+    struct region* region = (struct region*) shared;
+    struct transaction* transaction = (struct transaction*) tx;
+    // We allocate the dynamic segment such that its words are correctly
+    // aligned. Moreover, the alignment of the 'next' and 'prev' pointers must
+    // be satisfied. Thus, we use align on max(align, struct segment_node*).
+    size_t align = region->align;
+    align = align < sizeof(struct segment_node*) ? sizeof(void*) : align;
+
+    if (unlikely(!reserve(&(transaction->allocs), &(transaction->cap_allocs), transaction->n_allocs + 1, sizeof(void*))))
+        return nomem_alloc;
+    struct segment_node* sn;
+    if (unlikely(posix_memalign((void**)&sn, align, sizeof(struct segment_node) + size) != 0)) // Allocation failed
+        return nomem_alloc;
+
+    // Insert in the linked list
+    pthread_mutex_lock(&(region->allocs_lock));
+    sn->prev = NULL;
+    sn->next = region->allocs;
+    if (sn->next) sn->next->prev = sn;
+    region->allocs = sn;
+    pthread_mutex_unlock(&(region->allocs_lock));
+
+    void* segment = (void*) ((uintptr_t) sn + sizeof(struct segment_node));
+    memset(segment, 0, size);
+    transaction->allocs[transaction->n_allocs++] = segment;
+    *target = segment;
+    return success_alloc;
+}
+
+bool tm_free(shared_t shared, tx_t tx, void* segment) {
+    struct region* region = (struct region*) shared;
+    struct transaction* transaction = (struct transaction*) tx;
+    // Whoever could still reach the segment read a pointer to it, whose stripe
+    // the transaction must lock when unlinking it: the segment is freed on commit.
+    if (unlikely(!reserve(&(transaction->frees), &(transaction->cap_frees), transaction->n_frees + 1, sizeof(void*)))) {
+        abort_tx(region, transaction);
+        return false;
+    }
+    transaction->frees[transaction->n_frees++] = segment;
+    return true;
+}
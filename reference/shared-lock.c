@@ -23,3 +23,11 @@ bool shared_lock_acquire_shared(struct shared_lock_t* lock) {
 void shared_lock_release_shared(struct shared_lock_t* lock) {
     pthread_rwlock_unlock(&lock->rwlock);
 }
+
+bool shared_lock_try_acquire(struct shared_lock_t* lock) {
+    return pthread_rwlock_trywrlock(&lock->rwlock) == 0;
+}
+
+bool shared_lock_try_acquire_shared(struct shared_lock_t* lock) {
+    return pthread_rwlock_tryrdlock(&lock->rwlock) == 0;
+}
@@ -51,3 +51,15 @@ bool shared_lock_acquire_shared(struct shared_lock_t* lock);
  * @param lock Lock to release
 **/
 void shared_lock_release_shared(struct shared_lock_t* lock);
+
+/** Try to acquire the given lock exclusively, without waiting.
+ * @param lock Lock to acquire
+ * @return Whether the lock was acquired
+**/
+bool shared_lock_try_acquire(struct shared_lock_t* lock);
+
+/** Try to acquire the given lock non-exclusively, without waiting.
+ * @param lock Lock to acquire
+ * @return Whether the lock was acquired
+**/
+bool shared_lock_try_acquire_shared(struct shared_lock_t* lock);
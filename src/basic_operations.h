@@ -1,177 +1,1323 @@
 #ifndef _BASIC_OPERATIONS_H_
 #define _BASIC_OPERATIONS_H_
 
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include "coordinator.h"
+#include "feed.h"
+#include "futex.h"
+#include "log.h"
 #include "macros.h"
 #include "memory.h"
+#include "pages.h"
 #include "relinquish_cpu.h"
 
-static inline tx_t Enter(Region *region, bool is_ro)
+static inline ClaimResult Claim(Region *region, tx_t tx, tm_range_t const *ranges, size_t n_ranges);
+static inline void Reap(Region *region);
+
+static inline void Touch(Segment *segment)
+{
+  // Avoids bouncing the cache line once the flag is set
+  if (!atomic_load_explicit(&(segment->touched), memory_order_relaxed))
+  {
+    atomic_store(&(segment->touched), true);
+  }
+}
+
+static inline bool ReadOnly(tx_t tx)
+{
+  // Handles are never negative, but for the one of the first domain
+  return tx == RO_OWNER || (tx & READ_ONLY_TX) != 0;
+}
+
+static inline unsigned int Domains(tx_t tx)
+{
+  // Set of domains of the transaction, the first one when left empty
+  unsigned int domains = tx == RO_OWNER ? 0 : (tx >> DOMAIN_SHIFT) & ((1u << MAX_DOMAINS) - 1);
+  return domains == 0 ? 1 : domains;
+}
+
+static inline bool Within(const Segment *segment, tx_t tx)
+{
+  // Segments being set up belong to no domain
+  unsigned int domain = atomic_load_explicit(&(segment->domain), memory_order_acquire);
+  return domain != 0 && (Domains(tx) & (1u << (domain - 1))) != 0;
+}
+
+static inline Segment *Segments(const Region *region)
+{
+  return (Segment *)((char *)region + region->segments_offset);
+}
+
+static inline uint32_t *PageMap(const Region *region)
+{
+  return (uint32_t *)((char *)region + region->map_offset);
+}
+
+static inline atomic_ulong *Stamps(const Region *region)
+{
+  return (atomic_ulong *)((char *)region + region->stamps_offset);
+}
+
+static inline char *Data(const Region *region)
+{
+  return (char *)region + region->data_offset;
+}
+
+static inline void *SegmentData(const Region *region, const Segment *segment)
+{
+  return Data(region) + segment->offset;
+}
+
+static inline void *Shadow(const Region *region, const void *address)
+{
+  // Shadow area mirrors the data area right after it
+  return (char *)address + region->capacity;
+}
+
+static inline atomic_tx *Controls(const Region *region, const void *address)
+{
+  // One control word per word of the data area
+  return (atomic_tx *)((char *)region + region->controls_offset) + ((char *)address - Data(region)) / region->align;
+}
+
+static inline size_t Granule(const Region *region, size_t size)
+{
+#if defined(USE_HUGE_PAGES) || defined(USE_MAP_HUGETLB)
+  // Large segments are carved in whole huge pages
+  if (size >= HUGE_PAGE_SIZE && region->true_align <= HUGE_PAGE_SIZE)
+  {
+    return HUGE_PAGE_SIZE;
+  }
+#else
+  (void)size;
+#endif
+  return region->page_size > region->true_align ? region->page_size : region->true_align;
+}
+
+static inline size_t Footprint(const Region *region, size_t size)
+{
+  return RoundUp(size, Granule(region, size));
+}
+
+static inline bool AllocateData(Region *region, Segment *segment, size_t index)
+{
+  size_t granule = Granule(region, segment->size);
+  size_t length = RoundUp(segment->size, granule);
+
+  // Carving the segment out of the top of the data area
+  size_t top = atomic_load(&(region->top));
+  size_t offset;
+  do
+  {
+    offset = RoundUp(top, granule);
+    if (offset + length > region->capacity)
+    {
+      // Nothing carved, the segment holding no data to free
+      segment->size = 0;
+      return false;
+    }
+  } while (!atomic_compare_exchange_weak(&(region->top), &top, offset + length));
+  segment->offset = offset;
+
+  // Committing the data, its shadow copy and control words, which read as zeros
+  char *data = SegmentData(region, segment);
+  if (!CommitPages(data, length, !region->persistent && !region->shared) || !CommitPages(Shadow(region, data), length, !region->shared) || !CommitPages(Controls(region, data), (length / region->align) * sizeof(tx_t), !region->shared))
+  {
+    return false;
+  }
+
+  // Pointing the pages of the segment to it, the first segment existing from the start and others as of the epoch committing them
+  uint32_t *map = PageMap(region) + segment->offset / region->page_size;
+  atomic_ulong *stamps = Stamps(region) + segment->offset / region->page_size;
+  unsigned long int epoch = atomic_load(&(region->epoch)) + (index != 0);
+  for (size_t i = 0; i < length / region->page_size; ++i)
+  {
+    map[i] = index + 1;
+    atomic_store_explicit(stamps + i, epoch, memory_order_relaxed);
+  }
+  return true;
+}
+
+static inline void FreeData(Region *region, Segment *segment)
+{
+  // Already freed or never allocated
+  if (segment->size == 0)
+  {
+    return;
+  }
+
+  size_t length = Footprint(region, segment->size);
+  char *data = SegmentData(region, segment);
+
+  // Unmapping the pages of the segment
+  memset(PageMap(region) + segment->offset / region->page_size, 0, (length / region->page_size) * sizeof(uint32_t));
+
+  // Giving the memory back, the address range stays reserved
+  if (region->persistent || region->shared)
+  {
+    // Stays mapped from the file, must read as zeros once carved again
+    ClearPages(data, length);
+  }
+  else
+  {
+    DecommitPages(data, length);
+  }
+  if (region->shared)
+  {
+    // Other processes map the same pages
+    ClearPages(Shadow(region, data), length);
+    ClearPages(Controls(region, data), (length / region->align) * sizeof(tx_t));
+  }
+  else
+  {
+    DecommitPages(Shadow(region, data), length);
+    DecommitPages(Controls(region, data), (length / region->align) * sizeof(tx_t));
+  }
+
+  // Segment at the top of the data area can be carved again, other domains carving meanwhile
+  size_t top = segment->offset + length;
+  atomic_compare_exchange_strong(&(region->top), &top, segment->offset);
+  segment->size = 0;
+}
+
+static inline size_t ArenaAlignment(const Region *region)
+{
+  // Data area must be aligned for segments and, when configured, huge pages
+  size_t alignment = region->page_size > region->true_align ? region->page_size : region->true_align;
+#if defined(USE_HUGE_PAGES) || defined(USE_MAP_HUGETLB)
+  alignment = alignment > HUGE_PAGE_SIZE ? alignment : HUGE_PAGE_SIZE;
+#endif
+  return alignment;
+}
+
+static inline void LayoutRegion(Region *region, size_t align, size_t capacity)
+{
+  memset(region, 0, sizeof(Region));
+  region->align = align;
+  region->true_align = align < sizeof(void *) ? sizeof(void *) : align;
+  region->page_size = getpagesize();
+  region->capacity = capacity;
+  region->log.fd = -1;
+  region->feed.sink = -1;
+
+  // [region, segments, page map, page stamps, data, shadow copies, controls]
+  region->segments_offset = RoundUp(sizeof(Region), region->page_size);
+  region->map_offset = region->segments_offset + RoundUp(MAX_SEGMENTS * sizeof(Segment), region->page_size);
+  region->stamps_offset = region->map_offset + RoundUp((capacity / region->page_size) * sizeof(uint32_t), region->page_size);
+  region->data_offset = RoundUp(region->stamps_offset + RoundUp((capacity / region->page_size) * sizeof(atomic_ulong), region->page_size), ArenaAlignment(region));
+  region->controls_offset = region->data_offset + (capacity << 1);
+  region->length = region->controls_offset + RoundUp((capacity / align) * sizeof(tx_t), region->page_size);
+}
+
+static inline void ResetBatcher(Region *region)
+{
+  for (size_t d = 0; d < MAX_DOMAINS; ++d)
+  {
+    Batcher *batcher = region->domains + d;
+    atomic_store(&(batcher->turn), 0);
+    atomic_store(&(batcher->last_turn), 0);
+    atomic_store(&(batcher->n_turn_parked), 0);
+    atomic_store(&(batcher->n_entered), 0);
+    atomic_store(&(batcher->n_write_entered), 0);
+    atomic_store(&(batcher->n_write_slots), MAX_WRITE_TX_PER_EPOCH);
+    batcher->resumes = NULL;
+    atomic_store(&(batcher->holder), 0);
+    atomic_store(&(batcher->holding), false);
+  }
+  atomic_store(&(region->committing), 0);
+  region->commit_epoch = atomic_load(&(region->epoch));
+}
+
+static inline void Persist(Region *region)
+{
+  // Region, segments, page map and data area are mapped from the file
+  if (region->persistent)
+  {
+    msync(region, region->data_offset + region->capacity, MS_SYNC);
+  }
+}
+
+static inline void Checkpoint(Region *region)
+{
+  // Everything the log holds is in the file once synced
+  Persist(region);
+  LogTruncate(&(region->log));
+}
+
+/**
+ * @brief Writes a whole range to a file.
+ * @param fd File
+ * @param source Start of the range
+ * @param length Length of the range (bytes)
+ * @param offset Offset of the range in the file
+ * @return Whether the range was written
+ */
+static inline bool WriteAll(int fd, void const *source, size_t length, size_t offset)
+{
+  for (size_t written = 0; written < length;)
+  {
+    ssize_t n = pwrite(fd, (char const *)source + written, length - written, offset + written);
+    if (n <= 0)
+    {
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+static inline bool LogEpoch(Region *region, unsigned int domain)
+{
+  RedoLog *log = &(region->log);
+  if (!LogBegin(log))
+  {
+    return false;
+  }
+
+  // Segments are laid out as they will be after the commit
+  bool logged = true;
+  for (size_t i = region->index - 1; i < region->index; --i)
+  {
+    Segment *segment = Segments(region) + i;
+    if (atomic_load(&(segment->domain)) != domain + 1)
+    {
+      continue;
+    }
+
+    size_t segment_offset = (char *)segment - (char *)region;
+    size_t length = Footprint(region, segment->size);
+    size_t map_offset = region->map_offset + (segment->offset / region->page_size) * sizeof(uint32_t);
+
+    Segment committed;
+    memcpy(&committed, segment, sizeof(Segment));
+    atomic_store(&(committed.owner), NO_OWNER);
+    atomic_store(&(committed.status), DEFAULT);
+    atomic_store(&(committed.touched), false);
+    atomic_store(&(committed.domain), domain + 1);
+
+    int status = atomic_load(&(segment->status));
+    if (atomic_load(&(segment->owner)) == RM_OWNER || status == REMOVED || status == ADDED_AFTER_REMOVE)
+    {
+      // Already freed by an earlier epoch
+      if (segment->size == 0)
+      {
+        continue;
+      }
+
+      // Freeing the segment, its pages read as zeros once carved again
+      committed.size = 0;
+      atomic_store(&(committed.owner), RM_OWNER);
+      logged = logged && LogClear(log, region->data_offset + segment->offset, length) && LogAppend(log, map_offset, NULL, (length / region->page_size) * sizeof(uint32_t)) && LogAppend(log, segment_offset, &committed, sizeof(Segment));
+      continue;
+    }
+
+    // Keeping the segment allocated in this epoch
+    if (status == ADDED)
+    {
+      logged = logged && LogAppend(log, segment_offset, &committed, sizeof(Segment)) && LogAppend(log, map_offset, (char *)region + map_offset, (length / region->page_size) * sizeof(uint32_t));
+    }
+
+    if (!atomic_load(&(segment->touched)))
+    {
+      continue;
+    }
+
+    // Words written in this epoch, consecutive ones sharing one entry
+    char *data = SegmentData(region, segment);
+    atomic_tx *controls = Controls(region, data);
+    size_t max = segment->size / region->align;
+    for (size_t j = 0; j < max && logged;)
+    {
+      tx_t owner = atomic_load(controls + j);
+      if (owner == NO_OWNER || owner >= -owner)
+      {
+        ++j;
+        continue;
+      }
+
+      size_t first = j;
+      for (; j < max && (owner = atomic_load(controls + j)) != NO_OWNER && owner < -owner; ++j)
+      {
+      }
+      logged = LogAppend(log, region->data_offset + segment->offset + first * region->align, (char *)Shadow(region, data) + first * region->align, (j - first) * region->align);
+    }
+  }
+
+  // Segments allocated in this epoch moved these
+  logged = logged && LogAppend(log, offsetof(Region, index), &(region->index), sizeof(region->index)) && LogAppend(log, offsetof(Region, top), &(region->top), sizeof(region->top));
+
+  return logged && LogCommit(log, atomic_load(&(region->epoch)) + 1);
+}
+
+static inline void FeedEpoch(Region *region, unsigned int domain)
+{
+  ChangeFeed *feed = &(region->feed);
+  unsigned long int epoch = atomic_load(&(region->epoch)) + 1;
+
+  // For each segment written in this epoch and not freed by it
+  bool fed = true;
+  for (size_t i = region->index - 1; i < region->index && fed; --i)
+  {
+    Segment *segment = Segments(region) + i;
+    int status = atomic_load(&(segment->status));
+    if (atomic_load(&(segment->domain)) != domain + 1 || !atomic_load(&(segment->touched)) || atomic_load(&(segment->owner)) == RM_OWNER || status == REMOVED || status == ADDED_AFTER_REMOVE)
+    {
+      continue;
+    }
+
+    // Words written in this epoch, consecutive ones sharing one record
+    char *data = SegmentData(region, segment);
+    atomic_tx *controls = Controls(region, data);
+    size_t max = segment->size / region->align;
+    for (size_t j = 0; j < max && fed;)
+    {
+      tx_t owner = atomic_load(controls + j);
+      if (owner == NO_OWNER || owner >= -owner)
+      {
+        ++j;
+        continue;
+      }
+
+      size_t first = j;
+      for (; j < max && (owner = atomic_load(controls + j)) != NO_OWNER && owner < -owner; ++j)
+      {
+      }
+      fed = FeedAppend(feed, epoch, data, first * region->align, (char *)Shadow(region, data) + first * region->align, (j - first) * region->align);
+    }
+  }
+
+  FeedPublish(feed);
+}
+
+static inline bool InitRegion(Region *region, size_t size)
+{
+  atomic_store(&(region->index), 1);
+  atomic_store(&(region->top), 0);
+
+  // Initializing the batcher of each domain
+  for (size_t d = 0; d < MAX_DOMAINS; ++d)
+  {
+    atomic_store(&(region->domains[d].counter), 0);
+  }
+  atomic_store(&(region->epoch), 0);
+  ResetBatcher(region);
+
+  // Initializing the first segment, other slots read as zeros
+  Segment *segment = Segments(region);
+  segment->size = size;
+  atomic_store(&(segment->status), DEFAULT);
+  atomic_store(&(segment->owner), NO_OWNER);
+  atomic_store(&(segment->domain), 1);
+
+  // Carving the first segment out of the data area
+  if (!AllocateData(region, segment, 0))
+  {
+    return false;
+  }
+
+  // Region is only valid once everything else has reached the file
+  Persist(region);
+  region->magic = REGION_MAGIC;
+  Persist(region);
+  return true;
+}
+
+static inline bool RecoverRegion(Region *region)
+{
+  // Process stopped while applying an epoch it could not journal, the file is torn
+  if (region->applying_epoch != region->applied_epoch)
+  {
+    return false;
+  }
+
+  // Transactions of the interrupted epoch are gone
+  ResetBatcher(region);
+
+  // So is the checkpoint that was being written, pages it left busy included
+  for (size_t page = 0; page < atomic_load(&(region->top)) / region->page_size; ++page)
+  {
+    atomic_fetch_and(Stamps(region) + page, ~STAMP_BUSY);
+  }
+
+  // Only allocations and frees of the interrupted epoch can have reached the file
+  for (size_t i = atomic_load(&(region->index)) - 1; i < atomic_load(&(region->index)); --i)
+  {
+    Segment *segment = Segments(region) + i;
+    if (atomic_load(&(segment->status)) == ADDED || atomic_load(&(segment->status)) == ADDED_AFTER_REMOVE)
+    {
+      // Undoing the allocation, slots still being set up going back to the first domain
+      FreeData(region, segment);
+      atomic_store(&(segment->owner), RM_OWNER);
+      if (atomic_load(&(segment->domain)) == 0)
+      {
+        atomic_store(&(segment->domain), 1);
+      }
+    }
+    else if (atomic_load(&(segment->owner)) != RM_OWNER)
+    {
+      // Undoing the free
+      atomic_store(&(segment->owner), NO_OWNER);
+
+      // Shadow copy and control words are not persisted, they start over as zeros
+      size_t length = Footprint(region, segment->size);
+      char *data = SegmentData(region, segment);
+      if (!CommitPages(Shadow(region, data), length, true) || !CommitPages(Controls(region, data), (length / region->align) * sizeof(tx_t), true))
+      {
+        return false;
+      }
+    }
+    atomic_store(&(segment->status), DEFAULT);
+    atomic_store(&(segment->touched), false);
+    segment->last_access = atomic_load(&(region->domains[atomic_load(&(segment->domain)) - 1].counter));
+    segment->resident = false;
+  }
+
+  Persist(region);
+  return true;
+}
+
+static inline bool Dead(int pid)
+{
+  return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+static inline bool Exited(int pid)
+{
+  // Children killed stay zombies until waited for, which is left to their parent
+  siginfo_t info;
+  info.si_pid = 0;
+  if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0)
+  {
+    return info.si_pid == pid;
+  }
+  return Dead(pid);
+}
+
+static inline Attachment *Attached(Region *region)
+{
+  // Only regions in shared memory keep track of processes
+  if (!region->shared)
+  {
+    return NULL;
+  }
+
+  pid_t pid = getpid();
+  for (size_t i = 0; i < MAX_ATTACHMENTS; ++i)
+  {
+    if (atomic_load(&(region->attachments[i].pid)) == pid)
+    {
+      return region->attachments + i;
+    }
+  }
+  return NULL;
+}
+
+static inline int CheckpointFile(Region *region)
+{
+  // Opened once per checkpoint by each process, the ones attached to a shared region keeping theirs apart
+  Attachment *attachment = Attached(region);
+  int *fd = attachment != NULL ? &(attachment->checkpoint_fd) : &(region->checkpoint_fd);
+  unsigned long int *id = attachment != NULL ? &(attachment->checkpoint_id) : &(region->checkpoint_fd_id);
+  if (*id != region->checkpoint_id)
+  {
+    if (*id != 0)
+    {
+      close(*fd);
+    }
+    *fd = open(region->checkpoint_path, O_WRONLY | O_CLOEXEC);
+    *id = *fd >= 0 ? region->checkpoint_id : 0;
+  }
+  return *id != 0 ? *fd : -1;
+}
+
+static inline void Preserve(Region *region, size_t page, unsigned long int epoch)
+{
+  // Pages stamped after the checkpoint's epoch are written or preserved already
+  atomic_ulong *stamp = Stamps(region) + page;
+  unsigned long int value = atomic_load(stamp) & ~STAMP_BUSY;
+  if (value > region->checkpoint_epoch)
+  {
+    return;
+  }
+
+  // Pre-image, the same as the one the checkpoint's writer would write, which may be on the page meanwhile
+  int fd = CheckpointFile(region);
+  if (fd < 0 || !WriteAll(fd, Data(region) + page * region->page_size, region->page_size, region->data_offset + page * region->page_size))
+  {
+    atomic_store(&(region->checkpoint_failed), true);
+  }
+
+  // Writer skips the page once stamped, waiting for it to be done with the page otherwise
+  for (size_t spins = 1; !atomic_compare_exchange_weak(stamp, &value, epoch); ++spins)
+  {
+    value &= ~STAMP_BUSY;
+    if (spins % REAP_SPINS == 0 && Exited(region->checkpoint_writer))
+    {
+      // Writer died on the page, the checkpoint is lost
+      atomic_store(&(region->checkpointing), false);
+      atomic_store(stamp, epoch);
+      return;
+    }
+    relinquish_cpu();
+  }
+}
+
+static inline size_t Track(Attachment *attachment, size_t n_tx)
+{
+  if (attachment == NULL)
+  {
+    return MAX_ATTACHED_TX;
+  }
+
+  // Transactions beyond the table cannot be rolled back by others
+  for (size_t i = 0; i < MAX_ATTACHED_TX; ++i)
+  {
+    tx_t expected = NO_OWNER;
+    if (atomic_compare_exchange_strong(attachment->tx + i, &expected, RM_OWNER))
+    {
+      atomic_store(attachment->n_tx + i, n_tx);
+      atomic_store(attachment->entered + i, 0);
+      return i;
+    }
+  }
+  return MAX_ATTACHED_TX;
+}
+
+static inline void Untrack(Attachment *attachment, size_t entry)
+{
+  if (attachment != NULL && entry < MAX_ATTACHED_TX)
+  {
+    atomic_store(attachment->tx + entry, NO_OWNER);
+  }
+}
+
+static inline void Settle(Attachment *attachment, size_t entry, unsigned int domains)
+{
+  // Entries counted in no domain are free again
+  atomic_store(attachment->entered + entry, domains);
+  if ((domains & ~TRACKED_ENDED) == 0)
+  {
+    Untrack(attachment, entry);
+  }
+}
+
+static inline size_t Ending(Attachment *attachment, tx_t tx)
+{
+  if (attachment == NULL)
+  {
+    return MAX_ATTACHED_TX;
+  }
+
+  // Read-only transactions share identifiers, each thread ending a different entry
+  for (size_t i = 0; i < MAX_ATTACHED_TX; ++i)
+  {
+    unsigned int entered = atomic_load(attachment->entered + i);
+    if (atomic_load(attachment->tx + i) == tx && (entered & ~TRACKED_ENDED) != 0 && !(entered & TRACKED_ENDED) && atomic_compare_exchange_strong(attachment->entered + i, &entered, entered | TRACKED_ENDED))
+    {
+      return i;
+    }
+  }
+  return MAX_ATTACHED_TX;
+}
+
+static inline Waiter *Watch(Region *region, size_t start, size_t end)
+{
+  for (size_t i = 0; i < MAX_WAITERS; ++i)
+  {
+    Waiter *waiter = region->waiters + i;
+    int expected = WAITER_FREE;
+    if (atomic_compare_exchange_strong(&(waiter->state), &expected, WAITER_CLAIMED))
+    {
+      // Range is set before committers can see the waiter
+      waiter->start = start;
+      waiter->end = end;
+      atomic_fetch_add(&(region->n_waiters), 1);
+      atomic_store(&(waiter->state), WAITER_WAITING);
+      return waiter;
+    }
+  }
+  return NULL;
+}
+
+static inline void Unwatch(Region *region, Waiter *waiter)
+{
+  atomic_fetch_add(&(region->n_waiters), -1);
+  atomic_store(&(waiter->state), WAITER_FREE);
+}
+
+static inline void Notify(Region *region, size_t start, size_t end)
+{
+  // Waking exactly the threads whose range overlaps
+  for (size_t i = 0; i < MAX_WAITERS; ++i)
+  {
+    Waiter *waiter = region->waiters + i;
+    int expected = WAITER_WAITING;
+    if (atomic_load(&(waiter->state)) == WAITER_WAITING && waiter->start < end && start < waiter->end && atomic_compare_exchange_strong(&(waiter->state), &expected, WAITER_WOKEN))
+    {
+      FutexWake(&(waiter->state));
+    }
+  }
+}
+
+static inline void WaitEpoch(Region *region, Batcher *batcher, unsigned long int epoch)
+{
+  for (size_t spins = 1; epoch == atomic_load(&(batcher->counter)); ++spins)
+  {
+    // Transactions of dead processes would hold the epoch forever
+    if (region->shared && spins % REAP_SPINS == 0)
+    {
+      Reap(region);
+    }
+
+    // Threads of coordinated regions sleep until the next pass
+    if (region->coordinated && spins >= COORDINATOR_SPINS)
+    {
+      Park(&(batcher->counter), epoch);
+      continue;
+    }
+    relinquish_cpu();
+  }
+}
+
+static inline void Await(Batcher *batcher, tm_resume_t *resume)
+{
+  // Holding the turn, the epoch cannot commit meanwhile
+  resume->next = batcher->resumes;
+  batcher->resumes = resume;
+}
+
+static inline void Resume(Batcher *batcher)
+{
+  tm_resume_t *resume = batcher->resumes;
+  batcher->resumes = NULL;
+  while (resume != NULL)
+  {
+    // Continuation may be gone as soon as it is called
+    tm_resume_t *next = resume->next;
+    resume->resume(resume->arg);
+    resume = next;
+  }
+}
+
+static inline bool Uncommit(Region *region, int pid)
+{
+  // Taken over from the dead process, the epoch of the region being its own again
+  int committing = pid;
+  if (!atomic_compare_exchange_strong(&(region->committing), &committing, getpid()))
+  {
+    return false;
+  }
+
+  // Domain's epoch moves last, the commit being over once it did
+  if (atomic_load(&(region->epoch)) != region->commit_epoch)
+  {
+    Batcher *batcher = region->domains + region->commit_domain;
+    if (atomic_load(&(batcher->counter)) != batcher->held_counter)
+    {
+      region->commit_epoch = atomic_load(&(region->epoch));
+    }
+    else
+    {
+      atomic_store(&(region->epoch), region->commit_epoch);
+    }
+  }
+  return true;
+}
+
+static inline void Recover(Region *region, Batcher *batcher, int pid)
+{
+  // Commit left halfway is run again from the start, words already committed having no owner anymore
+  if (Uncommit(region, pid))
+  {
+    atomic_store(&(region->committing), 0);
+  }
+
+  // Holder died before changing anything
+  if (!atomic_load(&(batcher->holding)))
+  {
+    return;
+  }
+
+  // Change is done once the epoch committed or the transaction is counted where it goes
+  Attachment *attachment = batcher->held_attachment < 0 ? NULL : region->attachments + batcher->held_attachment;
+  bool done = atomic_load(&(batcher->counter)) != batcher->held_counter || (attachment != NULL && atomic_load(attachment->entered + batcher->held_entry) == batcher->held_domains);
+  if (done && attachment != NULL)
+  {
+    Settle(attachment, batcher->held_entry, batcher->held_domains);
+  }
+  else if (!done)
+  {
+    atomic_store(&(batcher->n_entered), batcher->held_entered);
+    atomic_store(&(batcher->n_write_slots), batcher->held_write_slots);
+    atomic_store(&(batcher->n_write_entered), batcher->held_write_entered);
+  }
+  atomic_store(&(batcher->holding), false);
+}
+
+static inline void TakeTurn(Region *region, Batcher *batcher)
+{
+  if (region->shared)
+  {
+    // Taken by whichever process gets it first, over from a dead one too
+    int pid = getpid();
+    for (size_t spins = 1;; ++spins)
+    {
+      int holder = 0;
+      if (atomic_compare_exchange_weak(&(batcher->holder), &holder, pid))
+      {
+        return;
+      }
+      if (spins % REAP_SPINS == 0 && Dead(holder) && atomic_compare_exchange_strong(&(batcher->holder), &holder, pid))
+      {
+        Recover(region, batcher, holder);
+        return;
+      }
+      relinquish_cpu();
+    }
+  }
+
+  unsigned long int turn = atomic_fetch_add(&(batcher->last_turn), 1);
+  for (size_t spins = 1; turn != atomic_load(&(batcher->turn)); ++spins)
+  {
+    // Threads of coordinated regions sleep until the turn moves
+    if (region->coordinated && spins >= COORDINATOR_SPINS)
+    {
+      ParkTurn(batcher, turn);
+      continue;
+    }
+    relinquish_cpu();
+  }
+}
+
+static inline void GiveTurn(Region *region, Batcher *batcher)
+{
+  if (region->shared)
+  {
+    atomic_store(&(batcher->holder), 0);
+    return;
+  }
+
+  atomic_fetch_add(&(batcher->turn), 1);
+  UnparkTurn(batcher);
+}
+
+static inline void Hold(Region *region, Batcher *batcher, Attachment *attachment, size_t entry, unsigned int domains)
+{
+  // Only processes sharing the region can die holding the turn
+  if (!region->shared)
+  {
+    return;
+  }
+
+  batcher->held_counter = atomic_load(&(batcher->counter));
+  batcher->held_entered = atomic_load(&(batcher->n_entered));
+  batcher->held_write_slots = atomic_load(&(batcher->n_write_slots));
+  batcher->held_write_entered = atomic_load(&(batcher->n_write_entered));
+  batcher->held_attachment = attachment == NULL || entry == MAX_ATTACHED_TX ? -1 : attachment - region->attachments;
+  batcher->held_entry = entry;
+  batcher->held_domains = domains;
+  atomic_store(&(batcher->holding), true);
+}
+
+static inline void Held(Region *region, Batcher *batcher)
+{
+  if (!region->shared)
+  {
+    return;
+  }
+
+  // Counting the transaction where it goes is what completes the change
+  if (batcher->held_attachment >= 0)
+  {
+    Settle(region->attachments + batcher->held_attachment, batcher->held_entry, batcher->held_domains);
+  }
+  atomic_store(&(batcher->holding), false);
+}
+
+static inline unsigned int Entered(Attachment *attachment, size_t entry)
+{
+  return attachment == NULL || entry == MAX_ATTACHED_TX ? 0 : atomic_load(attachment->entered + entry);
+}
+
+static inline tx_t Enter(Region *region, unsigned int domain, bool is_ro, size_t n_tx, tm_range_t const *ranges, size_t n_ranges, tm_resume_t *resume, Attachment *attachment, size_t entry)
 {
+  Batcher *batcher = region->domains + domain;
+
   if (is_ro)
   {
     // Waiting for our turn
-    unsigned long int turn = atomic_fetch_add(&(region->batcher.last_turn), 1);
-    while (turn != atomic_load(&(region->batcher.turn)))
-    {
-      relinquish_cpu();
-    }
+    TakeTurn(region, batcher);
 
     // Incrementing number of transactions that entered in batcher
-    atomic_fetch_add(&(region->batcher.n_entered), 1);
+    Hold(region, batcher, attachment, entry, Entered(attachment, entry) | (1u << domain));
+    atomic_fetch_add(&(batcher->n_entered), 1);
+    Held(region, batcher);
 
     // Giving away our turn
-    atomic_fetch_add(&(region->batcher.turn), 1);
+    GiveTurn(region, batcher);
 
     return RO_OWNER;
   }
 
+  tx_t tx;
   while (true)
   {
     // Waiting for our turn
-    unsigned long int turn = atomic_fetch_add(&(region->batcher.last_turn), 1);
-    while (turn != atomic_load(&(region->batcher.turn)))
+    TakeTurn(region, batcher);
+
+    if (atomic_load(&(batcher->n_write_slots)) != 0)
     {
-      relinquish_cpu();
+      // Holding the turn, identifiers only move once reserved below
+      tx = atomic_load(&(batcher->n_write_entered)) + 1;
+
+      // Declared write sets overlapping this epoch are pushed to the next one
+      ClaimResult claim = n_ranges == 0 ? CLAIMED : Claim(region, tx, ranges, n_ranges);
+      if (claim == CLAIMED)
+      {
+        // Counted in the domain once done, taken back should we die before
+        Hold(region, batcher, attachment, entry, Entered(attachment, entry) | (1u << domain));
+
+        // Reserving one identifier per write transaction sharing this admission
+        atomic_fetch_add(&(batcher->n_write_entered), n_tx);
+
+        // We can proceed
+        atomic_fetch_add(&(batcher->n_write_slots), -1);
+        break;
+      }
+      else if (claim == CLAIM_INVALID)
+      {
+        // Nothing was reserved, the epoch goes on without us
+        GiveTurn(region, batcher);
+        return invalid_tx;
+      }
     }
 
-    if (atomic_load(&(region->batcher.n_write_slots)) != 0)
+    // Giving away turn, no epoch commits before that
+    unsigned long int last = atomic_load(&(batcher->counter));
+    if (resume != NULL)
     {
-      // We can proceed
-      atomic_fetch_add(&(region->batcher.n_write_slots), -1);
-      break;
+      // Resumed by the commit of the epoch rather than waiting for it
+      Await(batcher, resume);
+      GiveTurn(region, batcher);
+      return invalid_tx;
     }
-
-    // Giving away turn
-    atomic_fetch_add(&(region->batcher.turn), 1);
+    GiveTurn(region, batcher);
 
     // Waiting for next epoch
-    unsigned long int last = atomic_load(&(region->batcher.counter));
-    while (last == atomic_load(&(region->batcher.counter)))
-    {
-      relinquish_cpu();
-    }
+    WaitEpoch(region, batcher, last);
   }
 
-  // Incrementing number of write transactions that entered
-  tx_t tx = atomic_fetch_add(&(region->batcher.n_write_entered), 1) + 1;
-
   // Incrementing number of transactions entered,
-  atomic_fetch_add(&(region->batcher.n_entered), 1);
+  atomic_fetch_add(&(batcher->n_entered), 1);
+  Held(region, batcher);
 
   // Giving away our turn
-  atomic_fetch_add(&(region->batcher.turn), 1);
+  GiveTurn(region, batcher);
 
   return tx;
 }
 
-static inline bool Leave(Region *region, tx_t tx)
+static inline tx_t Begin(Region *region, unsigned int domains, bool is_ro, size_t n_tx, tm_range_t const *ranges, size_t n_ranges)
 {
-  // Waiting for our turn
-  unsigned long int turn = atomic_fetch_add(&(region->batcher.last_turn), 1);
-  while (turn != atomic_load(&(region->batcher.turn)))
+  // Tracked before entering, so that others leave the domains it entered on its behalf should it die
+  Attachment *attachment = Attached(region);
+  size_t entry = Track(attachment, n_tx);
+
+  tx_t tx;
+  if ((domains & (domains - 1)) == 0)
+  {
+    // Confined to one domain, identifiers only need to be unique in its epoch
+    unsigned int domain = __builtin_ctz(domains);
+    tx_t tag = domain == 0 ? 0 : (tx_t)domains << DOMAIN_SHIFT;
+    tx = Enter(region, domain, is_ro, n_tx, ranges, n_ranges, NULL, attachment, entry);
+    if (tx == invalid_tx)
+    {
+      // Declared write set could not be claimed
+      Untrack(attachment, entry);
+      return invalid_tx;
+    }
+    if (tag != 0)
+    {
+      tx = is_ro ? READ_ONLY_TX | tag : tx | tag;
+    }
+  }
+  else
+  {
+    // Read-only transactions would see the epochs of each domain at different points, running as read-write ones
+    tx = (CROSS_TX + atomic_fetch_add(&(region->n_cross), 1) % CROSS_TX) | ((tx_t)domains << DOMAIN_SHIFT);
+
+    // Entering in order, transactions waiting for a domain never hold a later one
+    for (unsigned int domain = 0; domain < MAX_DOMAINS; ++domain)
+    {
+      if (domains & (1u << domain))
+      {
+        Enter(region, domain, false, 1, NULL, 0, NULL, attachment, entry);
+      }
+    }
+  }
+
+  // Only rolled back by others once known, having written nothing before
+  if (attachment != NULL && entry < MAX_ATTACHED_TX)
+  {
+    atomic_store(attachment->tx + entry, tx);
+  }
+  return tx;
+}
+
+static inline void Commit(Region *region, unsigned int domain)
+{
+  Batcher *batcher = region->domains + domain;
+
+  // Epochs of different domains commit one after the other, in the order of the region's epochs
+  int pid = getpid();
+  for (size_t spins = 1;; ++spins)
   {
+    int committing = 0;
+    if (atomic_compare_exchange_weak(&(region->committing), &committing, pid))
+    {
+      break;
+    }
+
+    // Process that died committing leaves its domain to whoever takes its turn over
+    if (region->shared && spins % REAP_SPINS == 0 && Dead(committing) && Uncommit(region, committing))
+    {
+      break;
+    }
     relinquish_cpu();
   }
+  region->commit_domain = domain;
 
-  // Check if this is the last write transaction
-  if (atomic_fetch_add(&region->batcher.n_entered, -1) == 1 && atomic_load(&(region->batcher.n_write_entered)))
+  // Durable once its record is in the log, applied to the file lazily
+  bool logged = region->log.fd >= 0 && LogEpoch(region, domain);
+
+  // Telling consumers what the epoch changes
+  if (region->feed.ring != NULL || region->feed.sink >= 0)
+  {
+    FeedEpoch(region, domain);
+  }
+
+  // Checkpoint being written from the pages as they were before the epoch
+  bool preserving = atomic_load(&(region->checkpointing));
+
+  // Without a record to replay, marking the epoch as being applied before any of its writes can reach the file
+  if (region->persistent && !logged)
+  {
+    region->applying_epoch = atomic_load(&(region->epoch)) + 1;
+    msync(region, region->page_size, MS_SYNC);
+  }
+
+  // Write transaction
+  for (size_t i = region->index - 1; i < region->index; --i)
   {
-    // Write transaction
-    for (size_t i = region->index - 1; i < region->index; --i)
+    Segment *segment = Segments(region) + i;
+
+    // Segments of other domains may be in use meanwhile
+    if (atomic_load(&(segment->domain)) != domain + 1)
+    {
+      continue;
+    }
+
+    // If this segment is meant to be deleted
+    if (atomic_load(&(segment->owner)) == RM_OWNER || atomic_load(&(segment->status)) == REMOVED || atomic_load(&(segment->status)) == ADDED_AFTER_REMOVE)
     {
-      Segment *segment = region->segments + i;
-      // If this segment is meant to be deleted
-      if (atomic_load(&(segment->owner)) == RM_OWNER || atomic_load(&(segment->status)) == REMOVED || atomic_load(&(segment->status)) == ADDED_AFTER_REMOVE)
+      // Threads waiting on the segment would wait forever
+      if (segment->size != 0 && atomic_load(&(region->n_waiters)) != 0)
       {
-        unsigned long int expected = i + 1;
-        if (!atomic_compare_exchange_strong(&(region->index), &expected, i))
+        Notify(region, segment->offset, segment->offset + segment->size);
+      }
+
+      // Freeing allocated space, once the checkpoint has what it held
+      if (preserving && segment->size != 0)
+      {
+        for (size_t page = segment->offset / region->page_size; page < (segment->offset + Footprint(region, segment->size)) / region->page_size; ++page)
         {
-          // Resetting owner and status flags
-          atomic_store(&(segment->status), DEFAULT);
-          atomic_store(&(segment->owner), RM_OWNER);
+          Preserve(region, page, atomic_load(&(region->epoch)) + 1);
         }
-        else
+      }
+      FreeData(region, segment);
+      atomic_store(&(segment->status), DEFAULT);
+      atomic_store(&(segment->owner), RM_OWNER);
+
+      // Slot on top can be handed out again, others stay unused until the ones above them are freed
+      unsigned long int expected = i + 1;
+      if (atomic_load(&(region->index)) == expected)
+      {
+        atomic_store(&(segment->domain), 0);
+        if (!atomic_compare_exchange_strong(&(region->index), &expected, i))
         {
-          // Freeing allocated space
-          free(segment->data);
-          segment->data = NULL;
+          // Slot above was allocated meanwhile
+          atomic_store(&(segment->domain), domain + 1);
         }
       }
-      else
+      continue;
+    }
+    else if (atomic_load(&(segment->touched)))
+    {
+      // Control words
+      char *data = SegmentData(region, segment);
+      atomic_tx *controls = Controls(region, data);
+
+      // Pages written in this epoch are stamped with it
+      atomic_ulong *stamps = Stamps(region) + segment->offset / region->page_size;
+      unsigned long int epoch = atomic_load(&(region->epoch)) + 1;
+
+      // Threads waiting for changes are only looked for when there are some
+      bool watched = atomic_load(&(region->n_waiters)) != 0;
+
+      // Only words accessed in this epoch are touched, leaving the other pages alone
+      size_t max = segment->size / region->align;
+      size_t preserved = SIZE_MAX;
+      for (size_t j = 0; j < max; ++j)
       {
-        // Commiting writes
-        memcpy(segment->data, (char *)(segment->data) + segment->size, segment->size);
+        tx_t owner = atomic_load(controls + j);
+        if (owner == NO_OWNER)
+        {
+          continue;
+        }
+
+        // Commiting writes, writers hold small identifiers and readers their negation
+        if (owner < -owner)
+        {
+          size_t page = (segment->offset + j * region->align) / region->page_size;
+          if (preserving && page != preserved)
+          {
+            Preserve(region, page, epoch);
+            preserved = page;
+          }
+          memcpy(data + j * region->align, (char *)Shadow(region, data) + j * region->align, region->align);
+          atomic_store_explicit(stamps + (j * region->align) / region->page_size, epoch, memory_order_relaxed);
+          if (watched)
+          {
+            Notify(region, segment->offset + j * region->align, segment->offset + (j + 1) * region->align);
+          }
+        }
 
-        // Reseting all the locks
-        bzero((char *)(segment->data) + (segment->size << 1), (segment->size / region->align) * sizeof(tx_t));
+        // Reseting the lock
+        atomic_store(controls + j, NO_OWNER);
       }
 
-      // Resetting owner and status flags
-      atomic_store(&(segment->owner), NO_OWNER);
-      atomic_store(&(segment->status), DEFAULT);
+      // Segment is hot again
+      atomic_store(&(segment->touched), false);
+      segment->last_access = atomic_load(&(batcher->counter));
+      segment->resident = true;
+    }
+    else if (segment->resident && atomic_load(&(batcher->counter)) - segment->last_access >= SHADOW_RECLAIM_EPOCHS)
+    {
+      // Cold segment, giving its shadow copy and control words back to the kernel
+      char *data = SegmentData(region, segment);
+      if (region->shared)
+      {
+        // Unmapping shared pages would not free them
+        ClearPages(Shadow(region, data), segment->size);
+        ClearPages(Controls(region, data), (segment->size / region->align) * sizeof(tx_t));
+      }
+      else
+      {
+        ReleasePages(Shadow(region, data), segment->size);
+        ReleasePages(Controls(region, data), (segment->size / region->align) * sizeof(tx_t));
+      }
+      segment->resident = false;
     }
 
-    // Resetting n_write_slots
-    atomic_store(&(region->batcher.n_write_slots), MAX_WRITE_TX_PER_EPOCH);
+    // Resetting owner and status flags
+    atomic_store(&(segment->owner), NO_OWNER);
+    atomic_store(&(segment->status), DEFAULT);
+  }
 
-    // Resetting n_write_entered
-    atomic_store(&(region->batcher.n_write_entered), 0);
+  // Epoch is only complete once all its writes have reached the file
+  if (logged)
+  {
+    if (region->log.size >= LOG_CHECKPOINT_BYTES)
+    {
+      Checkpoint(region);
+    }
+  }
+  else if (region->persistent)
+  {
+    Persist(region);
+    region->applied_epoch = region->applying_epoch;
+    msync(region, region->page_size, MS_SYNC);
 
-    // Moving to next epoch
-    atomic_fetch_add(&(region->batcher.counter), 1);
+    // Older records must not be replayed over this epoch
+    if (region->log.fd >= 0)
+    {
+      LogTruncate(&(region->log));
+    }
   }
-  else if (tx != RO_OWNER)
+
+  // Resetting n_write_slots
+  atomic_store(&(batcher->n_write_slots), MAX_WRITE_TX_PER_EPOCH);
+
+  // Resetting n_write_entered
+  atomic_store(&(batcher->n_write_entered), 0);
+
+  // Moving to next epoch, of the domain and of the region
+  atomic_fetch_add(&(region->epoch), 1);
+  atomic_fetch_add(&(batcher->counter), 1);
+  region->commit_epoch = atomic_load(&(region->epoch));
+  atomic_store(&(region->committing), 0);
+
+  // Handing the transactions waiting for the epoch back to their executors
+  if (batcher->resumes != NULL)
   {
-    // Giving away turn
-    atomic_fetch_add(&(region->batcher.turn), 1);
+    Resume(batcher);
+  }
+}
+
+static inline void Pass(Region *region, unsigned int domain)
+{
+  PendingCommit commit = {region, domain, NULL, false};
+  Defer(&commit);
 
-    // Waiting for the next epoch for atomic consistency
-    unsigned long int epoch = atomic_load(&(region->batcher.counter));
-    while (epoch == atomic_load(&(region->batcher.counter)))
+  // Whichever thread runs the pass commits the epochs of every coordinated region ready by then
+  while (!atomic_load(&(commit.done)))
+  {
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&(coordinator.passing), &idle, true))
     {
       relinquish_cpu();
+      continue;
     }
 
-    return true;
+    PendingCommit *pending = atomic_exchange(&(coordinator.pending), NULL);
+    while (pending != NULL)
+    {
+      // Entry belongs to the stack of a thread returning once it is done
+      PendingCommit *next = pending->next;
+      Commit(pending->region, pending->domain);
+      atomic_store(&(pending->done), true);
+      pending = next;
+    }
+
+    // Waking the threads parked on all these regions at once
+    Unpark();
+    atomic_store(&(coordinator.passing), false);
+  }
+}
+
+static inline bool Depart(Region *region, unsigned int domain, tx_t tx, Attachment *attachment, size_t entry, unsigned long int *epoch, tm_resume_t *resume)
+{
+  Batcher *batcher = region->domains + domain;
+
+  // Waiting for our turn
+  TakeTurn(region, batcher);
+
+  // Left already when leaving on behalf of a dead process, by the one it died holding the turn
+  if (attachment != NULL && entry < MAX_ATTACHED_TX && !(Entered(attachment, entry) & (1u << domain)))
+  {
+    GiveTurn(region, batcher);
+    return false;
+  }
+
+  // Counted in one domain less once done, the epoch committed again by whoever takes the turn over should we die
+  Hold(region, batcher, attachment, entry, Entered(attachment, entry) & ~(1u << domain));
+
+  // Check if this is the last write transaction
+  bool pending = false;
+  if (atomic_fetch_add(&(batcher->n_entered), -1) == 1 && atomic_load(&(batcher->n_write_entered)))
+  {
+    // Still holding the turn, nothing enters the epoch until it is committed
+    if (region->coordinated)
+    {
+      Pass(region, domain);
+    }
+    else
+    {
+      Commit(region, domain);
+    }
+  }
+  else if (!ReadOnly(tx))
+  {
+    // No epoch commits before we give away our turn
+    *epoch = atomic_load(&(batcher->counter));
+    pending = true;
+    if (resume != NULL)
+    {
+      Await(batcher, resume);
+    }
   }
 
   // Giving away turn
-  atomic_fetch_add(&(region->batcher.turn), 1);
+  Held(region, batcher);
+  GiveTurn(region, batcher);
 
-  return true;
+  return pending;
 }
 
-static inline Segment *LookupSegment(const Region *region, const void *source)
+static inline bool Leave(Region *region, tx_t tx)
 {
-  // For each segment in region
-  for (size_t i = region->index - 1; i < region->index; --i)
+  // Leaving every domain before waiting for any, each one waiting for the others otherwise
+  unsigned int domains = Domains(tx), pending = 0;
+  unsigned long int epochs[MAX_DOMAINS];
+
+  // Committed rather than rolled back from now on, by others leaving the domains left on its behalf should we die
+  Attachment *attachment = Attached(region);
+  size_t entry = Ending(attachment, tx);
+  for (unsigned int domain = 0; domain < MAX_DOMAINS; ++domain)
   {
-    // Segment has been deleted
-    if (atomic_load(&(region->segments[i].owner)) == RM_OWNER)
+    if (!(domains & (1u << domain)))
     {
-      return NULL;
+      continue;
     }
 
-    // Check if source is contained within segment's range
-    if ((char *)source >= (char *)region->segments[i].data && (char *)source < (char *)region->segments[i].data + region->segments[i].size)
+    if (Depart(region, domain, tx, attachment, entry, epochs + domain, NULL))
     {
-      return region->segments + i;
+      pending |= 1u << domain;
     }
   }
-  return NULL;
+
+  // Waiting for the next epochs for atomic consistency
+  for (unsigned int domain = 0; domain < MAX_DOMAINS; ++domain)
+  {
+    if (pending & (1u << domain))
+    {
+      WaitEpoch(region, region->domains + domain, epochs[domain]);
+    }
+  }
+
+  return true;
 }
 
-bool Lock(Region *region, Segment *segment, tx_t tx, void *target, size_t size)
+static inline Segment *LookupSegment(const Region *region, const void *source)
 {
-  // Beggining of the control words
-  size_t base_index = ((char *)target - (char *)segment->data) / region->align;
+  // Addresses outside of the data area belong to no segment
+  size_t offset = (char *)source - Data(region);
+  if (offset >= region->capacity)
+  {
+    return NULL;
+  }
+
+  // Page map tells which segment owns the page
+  uint32_t index = PageMap(region)[offset / region->page_size];
+  if (index == 0)
+  {
+    return NULL;
+  }
+
+  // Segment has been deleted, or source lies in its padding
+  Segment *segment = Segments(region) + index - 1;
+  if (atomic_load(&(segment->owner)) == RM_OWNER || offset - segment->offset >= segment->size)
+  {
+    return NULL;
+  }
+  return segment;
+}
 
+bool Lock(Region *region, Segment *segment, tx_t tx, void *target, size_t size)
+{
   // Getting the beggining of the controls words
-  atomic_tx *controls = (atomic_tx *)((char *)segment->data + (segment->size << 1)) + base_index;
+  atomic_tx *controls = Controls(region, target);
+
+  // Segment is written in this epoch
+  Touch(segment);
 
   // For each requested word
   size_t max = size / region->align;
@@ -194,19 +1340,83 @@ bool Lock(Region *region, Segment *segment, tx_t tx, void *target, size_t size)
   return true;
 }
 
-static inline void Undo(Region *region, tx_t tx)
+static inline void Release(Region *region, tx_t tx, tm_range_t const *ranges, size_t n_ranges)
+{
+  // For each declared range
+  for (size_t r = 0; r < n_ranges; ++r)
+  {
+    atomic_tx *controls = Controls(region, ranges[r].start);
+
+    // Unlocking the words we have claimed
+    size_t max = ranges[r].size / region->align;
+    for (size_t i = 0; i < max; ++i)
+    {
+      tx_t expected = tx;
+      atomic_compare_exchange_strong(controls + i, &expected, NO_OWNER);
+    }
+  }
+}
+
+static inline bool Declared(const Region *region, tm_range_t const *range)
+{
+  // Range must lie within a single segment, in whole words
+  Segment *segment = LookupSegment(region, range->start);
+  return segment != NULL && range->size % region->align == 0 && (char *)range->start + range->size <= (char *)SegmentData(region, segment) + segment->size;
+}
+
+static inline ClaimResult Claim(Region *region, tx_t tx, tm_range_t const *ranges, size_t n_ranges)
+{
+  // For each declared range
+  for (size_t r = 0; r < n_ranges; ++r)
+  {
+    // Segment may have been freed since the ranges were checked
+    if (!Declared(region, ranges + r))
+    {
+      Release(region, tx, ranges, r);
+      return CLAIM_INVALID;
+    }
+    Segment *segment = LookupSegment(region, ranges[r].start);
+    atomic_tx *controls = Controls(region, ranges[r].start);
+
+    // Segment is written in this epoch
+    Touch(segment);
+
+    // Locking every declared word up front
+    size_t max = ranges[r].size / region->align;
+    for (size_t i = 0; i < max; ++i)
+    {
+      tx_t expected = NO_OWNER;
+      if (atomic_compare_exchange_strong(controls + i, &expected, tx))
+      {
+        // Shadow copy may have been reclaimed, it must hold the committed word
+        memcpy((char *)Shadow(region, ranges[r].start) + i * region->align, (char *)ranges[r].start + i * region->align, region->align);
+      }
+      else if (expected != tx)
+      {
+        // Word already claimed or accessed in this epoch
+        Release(region, tx, ranges, r + 1);
+        return CLAIM_CONFLICT;
+      }
+    }
+  }
+
+  // Whole write set is ours until the epoch commits
+  return CLAIMED;
+}
+
+static inline void Rollback(Region *region, tx_t tx)
 {
   // For each segment in region
   for (size_t i = region->index - 1; i < region->index; --i)
   {
-    Segment *segment = region->segments + i;
+    Segment *segment = Segments(region) + i;
 
     // Undo malloc of new segment
     if ((atomic_load(&(segment->status)) == ADDED || atomic_load(&(segment->status)) == ADDED_AFTER_REMOVE) && tx == atomic_load(&segment->owner))
     {
       atomic_store(&(segment->owner), RM_OWNER);
     }
-    else if (segment->data != NULL && atomic_load(&(segment->owner)) != RM_OWNER)
+    else if (segment->size != 0 && atomic_load(&(segment->owner)) != RM_OWNER)
     {
       // Reset segment in case its ours
       if (atomic_load(&(segment->owner)) == tx)
@@ -215,8 +1425,15 @@ static inline void Undo(Region *region, tx_t tx)
         atomic_store(&(segment->status), DEFAULT);
       }
 
+      // No control word was set in this segment
+      if (!atomic_load(&(segment->touched)))
+      {
+        continue;
+      }
+
       // Control words
-      atomic_tx *controls = (atomic_tx *)((char *)segment->data + (segment->size << 1));
+      char *data = SegmentData(region, segment);
+      atomic_tx *controls = Controls(region, data);
 
       // For each word in the segment
       size_t max = segment->size / region->align;
@@ -225,7 +1442,7 @@ static inline void Undo(Region *region, tx_t tx)
         // If we are the owner
         if (atomic_load(controls + j) == tx)
         {
-          memcpy((char *)segment->data + segment->size + j * region->align, (char *)segment->data + j * region->align, region->align);
+          memcpy((char *)Shadow(region, data) + j * region->align, data + j * region->align, region->align);
           atomic_store(controls + j, NO_OWNER);
         }
         else
@@ -237,9 +1454,76 @@ static inline void Undo(Region *region, tx_t tx)
       }
     }
   }
+}
+
+static inline void Undo(Region *region, tx_t tx)
+{
+  Rollback(region, tx);
+
+  // Transactions of event loops leave without waiting for an epoch committing nothing of theirs
+  if (!ReadOnly(tx) && (tx & ASYNC_TX))
+  {
+    unsigned long int epoch;
+    Depart(region, 0, tx, NULL, MAX_ATTACHED_TX, &epoch, NULL);
+  }
+  // Batched transactions leave along with their whole batch
+  else if (ReadOnly(tx) || !(tx & BATCH_TX))
+  {
+    Leave(region, tx);
+  }
+}
+
+static inline void Reap(Region *region)
+{
+  for (size_t i = 0; i < MAX_ATTACHMENTS; ++i)
+  {
+    Attachment *attachment = region->attachments + i;
+
+    // Looking for processes that died while attached, or while reaping one that did
+    int pid = atomic_load(&(attachment->pid));
+    if (pid == 0 || !Dead(pid < 0 ? -pid : pid))
+    {
+      continue;
+    }
+
+    // Only one process rolls back the transactions of a dead one
+    if (!atomic_compare_exchange_strong(&(attachment->pid), &pid, -getpid()))
+    {
+      continue;
+    }
+
+    for (size_t j = 0; j < MAX_ATTACHED_TX; ++j)
+    {
+      tx_t tx = atomic_load(attachment->tx + j);
+      unsigned int entered = atomic_load(attachment->entered + j);
+      if (tx == NO_OWNER)
+      {
+        continue;
+      }
+
+      // Undoing the writes of transactions that did not end, batches reserving one identifier per transaction
+      if (!(entered & TRACKED_ENDED) && tx != RM_OWNER && !ReadOnly(tx))
+      {
+        Rollback(region, tx);
+        for (size_t k = 0; k < atomic_load(attachment->n_tx + j); ++k)
+        {
+          Rollback(region, (tx + k) | BATCH_TX);
+        }
+      }
+
+      // Leaving each domain it is counted in on its behalf, without waiting for the epochs, as seen holding their turn
+      unsigned long int epoch;
+      for (unsigned int domain = 0; domain < MAX_DOMAINS; ++domain)
+      {
+        Depart(region, domain, RO_OWNER, attachment, j, &epoch, NULL);
+      }
+      Untrack(attachment, j);
+    }
 
-  // Leaving transaction
-  Leave(region, tx);
+    // Freeing the slot for other processes, the object being kept rather than removed early should we die meanwhile
+    atomic_store(&(attachment->pid), 0);
+    atomic_fetch_add(&(region->n_attached), -1);
+  }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,141 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "basic_operations.h"
+#include "memory.h"
+
+/**
+ * @brief Writes one page of data to a checkpoint, unless a committer
+ * preserved it already, which it does once the page is stamped after
+ * the checkpoint's epoch (see Preserve).
+ * @param region Region the page belongs to
+ * @param page Index of the page in the data area
+ * @param length Number of bytes of the page to write
+ * @param epoch Epoch the checkpoint is taken at
+ * @param fd File to write to
+ * @return Whether the page was written or preserved
+ */
+static inline bool WritePage(Region *region, size_t page, size_t length, unsigned long int epoch, int fd)
+{
+  // Busy while written, committers waiting for it before changing the page
+  atomic_ulong *stamp = Stamps(region) + page;
+  unsigned long int value;
+  do
+  {
+    value = atomic_load(stamp) & ~STAMP_BUSY;
+    if (value > epoch)
+    {
+      return true;
+    }
+  } while (!atomic_compare_exchange_weak(stamp, &value, value | STAMP_BUSY));
+
+  bool written = WriteAll(fd, Data(region) + page * region->page_size, length, region->data_offset + page * region->page_size);
+  atomic_store(stamp, value);
+  return written;
+}
+
+/**
+ * @brief Writes the committed state of a region at an epoch boundary
+ * to a file laid out like the ones of tm_create_file, so it can be
+ * reopened with it. Allocations and frees in flight at the boundary
+ * are left out, and epochs committing meanwhile must preserve the
+ * pages they change (see Preserve). Only uses system calls, so it can
+ * run in a process forked from a multithreaded one.
+ * @param region Region whose data to write
+ * @param snapshot Header of the region at the boundary
+ * @param segments Segments of the region at the boundary
+ * @param fd Empty file to write to
+ * @return Whether the whole region was written and synced
+ */
+static inline bool WriteCheckpoint(Region *region, const Region *snapshot, const Segment *segments, int fd)
+{
+  // Header of a persistent region with no transaction running
+  Region header;
+  memcpy(&header, snapshot, sizeof(Region));
+  ResetBatcher(&header);
+  header.persistent = true;
+  unsigned long int epoch = atomic_load(&(snapshot->epoch));
+  header.applying_epoch = header.applied_epoch = epoch;
+  memset(&(header.log), 0, sizeof(RedoLog));
+  header.log.fd = -1;
+  memset(&(header.feed), 0, sizeof(ChangeFeed));
+  header.feed.sink = -1;
+  atomic_store(&(header.n_waiters), 0);
+  memset(header.waiters, 0, sizeof(header.waiters));
+  header.coordinated = false;
+  header.checkpoint = 0;
+  atomic_store(&(header.checkpointing), false);
+  atomic_store(&(header.checkpoint_failed), false);
+  header.checkpoint_writer = 0;
+  header.checkpoint_epoch = header.checkpoint_id = header.checkpoint_fd_id = 0;
+  memset(header.checkpoint_path, 0, sizeof(header.checkpoint_path));
+  header.checkpoint_fd = -1;
+  header.shared = false;
+  atomic_store(&(header.n_attached), 0);
+  memset(header.attachments, 0, sizeof(header.attachments));
+
+  bool written = WriteAll(fd, &header, sizeof(Region), 0);
+
+  // For each segment in region
+  size_t index = atomic_load(&(snapshot->index));
+  for (size_t i = 0; i < index && written; ++i)
+  {
+    Segment segment;
+    memcpy(&segment, segments + i, sizeof(Segment));
+
+    // Segments allocated in the current epoch do not exist yet, freed ones still do
+    int status = atomic_load(&(segment.status));
+    bool committed = segment.size != 0 && atomic_load(&(segment.owner)) != RM_OWNER && status != ADDED && status != ADDED_AFTER_REMOVE;
+    if (!committed)
+    {
+      // Slots still being set up are given back by the first domain
+      segment.size = 0;
+      if (atomic_load(&(segment.domain)) == 0)
+      {
+        atomic_store(&(segment.domain), 1);
+      }
+    }
+    atomic_store(&(segment.owner), committed ? NO_OWNER : RM_OWNER);
+    atomic_store(&(segment.status), DEFAULT);
+    atomic_store(&(segment.touched), false);
+    segment.resident = false;
+
+    written = WriteAll(fd, &segment, sizeof(Segment), region->segments_offset + i * sizeof(Segment));
+    if (!committed)
+    {
+      continue;
+    }
+
+    // Pages of the segment, chunk by chunk
+    uint32_t map[1024];
+    for (size_t j = 0; j < sizeof(map) / sizeof(uint32_t); ++j)
+    {
+      map[j] = i + 1;
+    }
+    size_t pages = Footprint(region, segment.size) / region->page_size;
+    for (size_t j = 0; j < pages && written; j += sizeof(map) / sizeof(uint32_t))
+    {
+      size_t chunk = pages - j < sizeof(map) / sizeof(uint32_t) ? pages - j : sizeof(map) / sizeof(uint32_t);
+      written = WriteAll(fd, map, chunk * sizeof(uint32_t), region->map_offset + (segment.offset / region->page_size + j) * sizeof(uint32_t));
+    }
+
+    // Data, page by page as of the boundary
+    size_t end = segment.offset + segment.size;
+    for (size_t page = segment.offset / region->page_size; page * region->page_size < end && written; ++page)
+    {
+      size_t length = end - page * region->page_size < region->page_size ? end - page * region->page_size : region->page_size;
+      written = WritePage(region, page, length, epoch, fd);
+    }
+  }
+
+  // Rest of the data area reads as zeros
+  return written && ftruncate(fd, region->data_offset + region->capacity) == 0 && fsync(fd) == 0;
+}
+
+#endif
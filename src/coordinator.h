@@ -0,0 +1,131 @@
+#ifndef _COORDINATOR_H_
+#define _COORDINATOR_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "futex.h"
+#include "memory.h"
+#include "relinquish_cpu.h"
+
+/// @brief Number of times a thread of a coordinated region
+/// yields while waiting for an epoch before going to sleep.
+#ifndef COORDINATOR_SPINS
+#define COORDINATOR_SPINS 64
+#endif
+
+/// @brief Epoch of a coordinated region that is
+/// ready to commit, waiting for the next pass.
+typedef struct _PendingCommit
+{
+  /// @brief Region to commit
+  Region *region;
+  /// @brief Domain of the region to commit
+  unsigned int domain;
+  /// @brief Next epoch waiting for the pass
+  struct _PendingCommit *next;
+  /// @brief Whether the epoch has been committed
+  atomic_bool done;
+} PendingCommit;
+
+/// @brief Process-wide coordinator of the epochs of
+/// the regions handed over to it (see tm_coordinate).
+typedef struct _Coordinator
+{
+  /// @brief Bumped by each pass committing epochs,
+  /// also the futex every parked thread sleeps on
+  atomic_int generation;
+  /// @brief Number of threads parked on the generation
+  atomic_int n_parked;
+  /// @brief Epochs waiting for the next pass
+  _Atomic(PendingCommit *) pending;
+  /// @brief Whether a thread is running a pass
+  atomic_bool passing;
+} Coordinator;
+
+/// @brief Coordinator of the library, defined in tm.c. Each
+/// library loaded in the process has its own, coordinating
+/// only the regions it created.
+extern Coordinator coordinator;
+
+/**
+ * @brief Puts the calling thread to sleep until the next pass of the
+ * coordinator, unless the epoch it waits for is already over.
+ * @param counter Epoch counter of the batcher
+ * @param epoch Epoch being waited for the end of
+ */
+static inline void Park(atomic_ulong *counter, unsigned long int epoch)
+{
+  int generation = atomic_load(&(coordinator.generation));
+  atomic_fetch_add(&(coordinator.n_parked), 1);
+
+  // Counter moving after this is followed by a new generation
+  if (epoch == atomic_load(counter))
+  {
+    FutexWait(&(coordinator.generation), generation);
+  }
+
+  atomic_fetch_add(&(coordinator.n_parked), -1);
+}
+
+/**
+ * @brief Puts the calling thread to sleep until the turn of the batcher
+ * moves, unless it already reached the one waited for.
+ * @param batcher Batcher of a coordinated region
+ * @param turn Turn being waited for
+ */
+static inline void ParkTurn(Batcher *batcher, unsigned long int turn)
+{
+  int generation = atomic_load(&(batcher->turn_generation));
+  atomic_fetch_add(&(batcher->n_turn_parked), 1);
+
+  // Turn moving after this is followed by a new generation
+  if (turn != atomic_load(&(batcher->turn)))
+  {
+    FutexWait(&(batcher->turn_generation), generation);
+  }
+
+  atomic_fetch_add(&(batcher->n_turn_parked), -1);
+}
+
+/**
+ * @brief Wakes the threads parked waiting for the turn of the batcher, if
+ * any, once it moved.
+ * @param batcher Batcher whose turn was given away
+ */
+static inline void UnparkTurn(Batcher *batcher)
+{
+  if (atomic_load(&(batcher->n_turn_parked)) != 0)
+  {
+    atomic_fetch_add(&(batcher->turn_generation), 1);
+    FutexWake(&(batcher->turn_generation));
+  }
+}
+
+/**
+ * @brief Starts a new generation once a pass is over, waking every parked
+ * thread with a single system call whatever region it waits on.
+ */
+static inline void Unpark()
+{
+  atomic_fetch_add(&(coordinator.generation), 1);
+  if (atomic_load(&(coordinator.n_parked)) != 0)
+  {
+    FutexWake(&(coordinator.generation));
+  }
+}
+
+/**
+ * @brief Hands an epoch ready to commit over to the next pass.
+ * @param commit Epoch, which must outlive the pass
+ */
+static inline void Defer(PendingCommit *commit)
+{
+  PendingCommit *head = atomic_load(&(coordinator.pending));
+  do
+  {
+    commit->next = head;
+  } while (!atomic_compare_exchange_weak(&(coordinator.pending), &head, commit));
+}
+
+#endif
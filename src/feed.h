@@ -0,0 +1,180 @@
+#ifndef _FEED_H_
+#define _FEED_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "pages.h"
+
+/**
+ * @brief Length of a record of the change feed, header included.
+ * @param change Header of the record
+ * @return Length of the record (bytes)
+ */
+static inline size_t ChangeLength(tm_change_t const *change)
+{
+  return sizeof(tm_change_t) + RoundUp(change->size, 8);
+}
+
+/**
+ * @brief Adds the bytes written to a range of a segment to the records of the epoch.
+ * @param feed Change feed
+ * @param epoch Epoch committing the bytes
+ * @param segment First byte of the segment
+ * @param offset Offset of the range in the segment
+ * @param source Bytes of the range
+ * @param size Length of the range (bytes)
+ * @return Whether the record could be added
+ */
+static inline bool FeedAppend(ChangeFeed *feed, unsigned long int epoch, void *segment, size_t offset, void const *source, size_t size)
+{
+  tm_change_t change = {epoch, segment, offset, size};
+  size_t length = ChangeLength(&change);
+
+  if (feed->length + length > feed->buffer_capacity)
+  {
+    size_t capacity = feed->buffer_capacity == 0 ? 4096 : feed->buffer_capacity;
+    while (feed->length + length > capacity)
+    {
+      capacity <<= 1;
+    }
+
+    char *buffer = realloc(feed->buffer, capacity);
+    if (buffer == NULL)
+    {
+      return false;
+    }
+    feed->buffer = buffer;
+    feed->buffer_capacity = capacity;
+  }
+
+  char *room = feed->buffer + feed->length;
+  memcpy(room, &change, sizeof(tm_change_t));
+  memcpy(room + sizeof(tm_change_t), source, size);
+  memset(room + sizeof(tm_change_t) + size, 0, length - sizeof(tm_change_t) - size);
+  feed->length += length;
+  return true;
+}
+
+/**
+ * @brief Publishes the records of the epoch to the ring, overwriting the
+ * oldest ones, then to the sink with a single write. Only one thread may
+ * publish at a time, any number may read the ring meanwhile.
+ * @param feed Change feed
+ */
+static inline void FeedPublish(ChangeFeed *feed)
+{
+  for (size_t i = 0; i < feed->length && feed->ring != NULL;)
+  {
+    tm_change_t const *change = (tm_change_t const *)(feed->buffer + i);
+    size_t length = ChangeLength(change);
+    i += length;
+
+    size_t head = atomic_load_explicit(&(feed->head), memory_order_relaxed);
+    if (length > feed->ring_capacity)
+    {
+      // Record cannot fit, readers of it are told they lost it
+      atomic_store(&(feed->writing), head + feed->ring_capacity + length);
+      atomic_store(&(feed->head), head + feed->ring_capacity + length);
+      continue;
+    }
+
+    // Records never wrap around, skipping to the start of the ring
+    size_t position = head % feed->ring_capacity;
+    size_t skip = position + length > feed->ring_capacity ? feed->ring_capacity - position : 0;
+
+    // Readers check this before trusting what they copied
+    atomic_store(&(feed->writing), head + skip + length);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (skip >= sizeof(tm_change_t))
+    {
+      tm_change_t padding = {0, NULL, 0, skip - sizeof(tm_change_t)};
+      memcpy(feed->ring + position, &padding, sizeof(tm_change_t));
+    }
+    memcpy(feed->ring + (head + skip) % feed->ring_capacity, change, length);
+
+    atomic_store_explicit(&(feed->head), head + skip + length, memory_order_release);
+  }
+
+  // Sink consumers get the epoch at once
+  for (size_t written = 0; feed->sink >= 0 && written < feed->length;)
+  {
+    ssize_t n = write(feed->sink, feed->buffer + written, feed->length - written);
+    if (n <= 0)
+    {
+      break;
+    }
+    written += n;
+  }
+
+  feed->length = 0;
+}
+
+/**
+ * @brief Copies the records published to the ring since a cursor.
+ * @param feed Change feed
+ * @param cursor Position of the first record to copy, moved past the copied ones
+ * @param buffer Receives the records
+ * @param length Length of the buffer (bytes)
+ * @return Number of bytes copied, -1 when records since the cursor were
+ * overwritten, the cursor then moving to the newest record
+ */
+static inline ssize_t FeedRead(ChangeFeed *feed, unsigned long long *cursor, void *buffer, size_t length)
+{
+  size_t head = atomic_load_explicit(&(feed->head), memory_order_acquire);
+  size_t position = *cursor, copied = 0;
+  bool lost = head - position > feed->ring_capacity;
+
+  while (!lost && position < head)
+  {
+    size_t offset = position % feed->ring_capacity;
+    if (feed->ring_capacity - offset < sizeof(tm_change_t))
+    {
+      position += feed->ring_capacity - offset;
+      continue;
+    }
+
+    tm_change_t change;
+    memcpy(&change, feed->ring + offset, sizeof(tm_change_t));
+    size_t record = ChangeLength(&change);
+    if (offset + record > feed->ring_capacity)
+    {
+      // Overwritten while being read
+      lost = true;
+      break;
+    }
+    if (change.segment == NULL)
+    {
+      // Padding up to the end of the ring
+      position += record;
+      continue;
+    }
+    if (copied + record > length)
+    {
+      break;
+    }
+
+    memcpy((char *)buffer + copied, feed->ring + offset, record);
+    copied += record;
+    position += record;
+  }
+
+  // Nothing copied may have been overwritten meanwhile
+  atomic_thread_fence(memory_order_seq_cst);
+  if (lost || atomic_load(&(feed->writing)) > *cursor + feed->ring_capacity)
+  {
+    *cursor = atomic_load(&(feed->head));
+    return -1;
+  }
+
+  *cursor = position;
+  return copied;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Puts the calling thread to sleep as long as a word holds a value.
+ * Works across processes sharing the word.
+ * @param word Word to wait on
+ * @param value Value the word holds while the thread should sleep
+ */
+static inline void FutexWait(atomic_int *word, int value)
+{
+  syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+/**
+ * @brief Wakes up the threads sleeping on a word.
+ * @param word Word they wait on
+ */
+static inline void FutexWake(atomic_int *word)
+{
+  syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "pages.h"
+
+/// @brief Marks the start of each
+/// record of a redo log ("STM453L1").
+#define LOG_MAGIC 0x53544d3435334c31UL
+
+/// @brief Set on the offset of entries zeroing
+/// whole pages, which carry no bytes.
+#define LOG_CLEAR ((uint64_t)1 << 63)
+
+/// @brief Header of the record holding all
+/// the writes of one committed epoch.
+typedef struct _LogRecord
+{
+  /// @brief LOG_MAGIC
+  uint64_t magic;
+  /// @brief Epoch the writes belong to
+  uint64_t epoch;
+  /// @brief Length of the entries following the header (bytes)
+  uint64_t length;
+  /// @brief FNV-1a hash of the entries, telling
+  /// a complete record from a torn one
+  uint64_t checksum;
+} LogRecord;
+
+/// @brief Header of one entry of a record, followed
+/// by its bytes padded to a multiple of 8.
+typedef struct _LogEntry
+{
+  /// @brief Offset of the bytes from the start of the region
+  uint64_t offset;
+  /// @brief Number of bytes
+  uint64_t length;
+} LogEntry;
+
+/**
+ * @brief Hashes a range of bytes.
+ * @param data Start of the range
+ * @param length Length of the range (bytes)
+ * @return FNV-1a hash of the range
+ */
+static inline uint64_t LogChecksum(void const *data, size_t length)
+{
+  uint64_t hash = 0xcbf29ce484222325UL;
+  for (size_t i = 0; i < length; ++i)
+  {
+    hash = (hash ^ ((unsigned char const *)data)[i]) * 0x100000001b3UL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Makes room for more bytes at the end of the pending record.
+ * @param log Redo log
+ * @param length Number of bytes to add
+ * @return Start of the room, NULL on failure
+ */
+static inline char *LogReserve(RedoLog *log, size_t length)
+{
+  if (log->length + length > log->capacity)
+  {
+    size_t capacity = log->capacity == 0 ? 4096 : log->capacity;
+    while (log->length + length > capacity)
+    {
+      capacity <<= 1;
+    }
+
+    char *buffer = realloc(log->buffer, capacity);
+    if (buffer == NULL)
+    {
+      return NULL;
+    }
+    log->buffer = buffer;
+    log->capacity = capacity;
+  }
+
+  char *room = log->buffer + log->length;
+  log->length += length;
+  return room;
+}
+
+/**
+ * @brief Starts the record of an epoch.
+ * @param log Redo log
+ * @return Whether the record could be started
+ */
+static inline bool LogBegin(RedoLog *log)
+{
+  log->length = 0;
+  return LogReserve(log, sizeof(LogRecord)) != NULL;
+}
+
+/**
+ * @brief Adds the bytes written to a range of the region to the pending record.
+ * @param log Redo log
+ * @param offset Offset of the range from the start of the region
+ * @param source Bytes of the range, NULL for zeros
+ * @param length Length of the range (bytes)
+ * @return Whether the entry could be added
+ */
+static inline bool LogAppend(RedoLog *log, size_t offset, void const *source, size_t length)
+{
+  char *room = LogReserve(log, sizeof(LogEntry) + RoundUp(length, 8));
+  if (room == NULL)
+  {
+    return false;
+  }
+
+  LogEntry entry = {offset, length};
+  memcpy(room, &entry, sizeof(LogEntry));
+  if (source != NULL)
+  {
+    memcpy(room + sizeof(LogEntry), source, length);
+    memset(room + sizeof(LogEntry) + length, 0, RoundUp(length, 8) - length);
+  }
+  else
+  {
+    memset(room + sizeof(LogEntry), 0, RoundUp(length, 8));
+  }
+  return true;
+}
+
+/**
+ * @brief Adds the zeroing of whole pages of the region to the pending record.
+ * @param log Redo log
+ * @param offset Offset of the pages from the start of the region
+ * @param length Length of the pages (bytes)
+ * @return Whether the entry could be added
+ */
+static inline bool LogClear(RedoLog *log, size_t offset, size_t length)
+{
+  char *room = LogReserve(log, sizeof(LogEntry));
+  if (room == NULL)
+  {
+    return false;
+  }
+
+  LogEntry entry = {offset | LOG_CLEAR, length};
+  memcpy(room, &entry, sizeof(LogEntry));
+  return true;
+}
+
+/**
+ * @brief Appends the pending record to the log file and waits
+ * until it is durable, with a single fdatasync.
+ * @param log Redo log
+ * @param epoch Epoch the record belongs to
+ * @return Whether the record is durable
+ */
+static inline bool LogCommit(RedoLog *log, unsigned long int epoch)
+{
+  LogRecord record = {LOG_MAGIC, epoch, log->length - sizeof(LogRecord), 0};
+  record.checksum = LogChecksum(log->buffer + sizeof(LogRecord), record.length);
+  memcpy(log->buffer, &record, sizeof(LogRecord));
+
+  for (size_t written = 0; written < log->length;)
+  {
+    ssize_t n = pwrite(log->fd, log->buffer + written, log->length - written, log->size + written);
+    if (n <= 0)
+    {
+      return false;
+    }
+    written += n;
+  }
+  if (fdatasync(log->fd) != 0)
+  {
+    return false;
+  }
+
+  log->size += log->length;
+  return true;
+}
+
+/**
+ * @brief Empties the log file, once everything it holds has reached the region's file.
+ * @param log Redo log
+ */
+static inline void LogTruncate(RedoLog *log)
+{
+  if (ftruncate(log->fd, 0) == 0 && fsync(log->fd) == 0)
+  {
+    log->size = 0;
+  }
+}
+
+/**
+ * @brief Applies every complete record of the log file to the region, in
+ * order, and drops the torn record a crash may have left at its end.
+ * @param log Redo log
+ * @param base Start of the region
+ * @param limit Length of the part of the region that can be written (bytes)
+ * @return Last epoch replayed, 0 when the log is empty
+ */
+static inline unsigned long int LogReplay(RedoLog *log, char *base, size_t limit)
+{
+  unsigned long int epoch = 0;
+  off_t end = lseek(log->fd, 0, SEEK_END);
+
+  off_t position = 0;
+  LogRecord record;
+  while (position + (off_t)sizeof(LogRecord) <= end && pread(log->fd, &record, sizeof(LogRecord), position) == sizeof(LogRecord))
+  {
+    if (record.magic != LOG_MAGIC || position + (off_t)(sizeof(LogRecord) + record.length) > end)
+    {
+      break;
+    }
+
+    // Reading the whole record before applying any of it
+    log->length = 0;
+    char *entries = LogReserve(log, record.length);
+    if (entries == NULL || pread(log->fd, entries, record.length, position + sizeof(LogRecord)) != (ssize_t)record.length || LogChecksum(entries, record.length) != record.checksum)
+    {
+      break;
+    }
+
+    for (size_t i = 0; i < record.length;)
+    {
+      LogEntry entry;
+      memcpy(&entry, entries + i, sizeof(LogEntry));
+      i += sizeof(LogEntry);
+
+      size_t offset = entry.offset & ~LOG_CLEAR;
+      bool fits = offset + entry.length <= limit;
+      if (entry.offset & LOG_CLEAR)
+      {
+        if (fits)
+        {
+          ClearPages(base + offset, entry.length);
+        }
+      }
+      else
+      {
+        if (fits)
+        {
+          memcpy(base + offset, entries + i, entry.length);
+        }
+        i += RoundUp(entry.length, 8);
+      }
+    }
+
+    epoch = record.epoch;
+    position += sizeof(LogRecord) + record.length;
+  }
+
+  // Next records go right after the last complete one
+  if (ftruncate(log->fd, position) == 0)
+  {
+    log->size = position;
+  }
+  return epoch;
+}
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef _MEMORY_H_
 #define _MEMORY_H_
 
-#include <tm.h>
+#include <tm_ext.h>
+#include <limits.h>
 #include <stdatomic.h>
+#include <sys/types.h>
 
 typedef _Atomic(tx_t) atomic_tx;
 
@@ -40,6 +42,39 @@ typedef enum _SegmentOwner
   RM_OWNER = UINTPTR_MAX - 2,
 } SegmentOwner;
 
+/// @brief Used for tagging transaction
+/// identifiers handed out by the batcher.
+typedef enum _TransactionFlags
+{
+  /// @brief Set on transactions that were
+  /// admitted together through tm_run_batch.
+  BATCH_TX = (tx_t)1 << 48,
+  /// @brief Set on read-only transactions of
+  /// domains other than the first one.
+  READ_ONLY_TX = (tx_t)1 << 49,
+  /// @brief Set on read-write transactions begun through
+  /// tm_begin_async, which leave without waiting for
+  /// the epoch when they abort.
+  ASYNC_TX = (tx_t)1 << 50,
+  /// @brief First identifier of the transactions
+  /// spanning several domains, the ones of other
+  /// transactions being reset with each epoch.
+  CROSS_TX = (tx_t)1 << 32,
+  /// @brief Position of the set of domains of
+  /// a transaction in its identifier, left empty
+  /// for transactions of the first domain only.
+  DOMAIN_SHIFT = 40,
+} TransactionFlags;
+
+/// @brief Used for partitioning a region
+/// into independent domains.
+typedef enum _DomainLimits
+{
+  /// @brief Maximum number of domains of a region,
+  /// each with its own batcher and epochs.
+  MAX_DOMAINS = 8,
+} DomainLimits;
+
 /// @brief Used for expressing
 /// the region's batcher current status.
 typedef enum _BatcherCounterStatus
@@ -47,14 +82,107 @@ typedef enum _BatcherCounterStatus
   /// @brief Maximum number of threads
   /// the batcher can handle at each epoch
   MAX_WRITE_TX_PER_EPOCH = 16,
+  /// @brief Maximum number of admissions a
+  /// batch gets to commit all its transactions
+  MAX_BATCH_ATTEMPTS = 16,
 } BatcherCounterStatus;
 
+/// @brief Used for laying out the arena
+/// holding a region and all its segments.
+typedef enum _ArenaLayout
+{
+  /// @brief Maximum number of segments
+  /// a region can hold at once.
+  MAX_SEGMENTS = 1 << 16,
+  /// @brief Marks the start of a region
+  /// persisted in a file ("STM453R7").
+  REGION_MAGIC = 0x53544d3435335237,
+} ArenaLayout;
+
+/// @brief Used for bounding the processes
+/// attached to a region in shared memory.
+typedef enum _SharedLimits
+{
+  /// @brief Maximum number of processes
+  /// attached to a region at once.
+  MAX_ATTACHMENTS = 64,
+  /// @brief Maximum number of transactions of one process
+  /// that can be rolled back should the process die.
+  MAX_ATTACHED_TX = 64,
+  /// @brief Number of times a thread waits for the next epoch,
+  /// the turn of a batcher or a commit before looking for dead
+  /// processes holding them.
+  REAP_SPINS = 1 << 12,
+} SharedLimits;
+
+/// @brief Used for expressing the state
+/// of a slot of the table of waiters.
+typedef enum _WaiterState
+{
+  /// @brief Slot is unused.
+  WAITER_FREE,
+  /// @brief Slot is being filled.
+  WAITER_CLAIMED,
+  /// @brief Thread waits for a write to its range.
+  WAITER_WAITING,
+  /// @brief A write to its range has been committed.
+  WAITER_WOKEN,
+  /// @brief Maximum number of threads waiting
+  /// for changes to a region at once.
+  MAX_WAITERS = 64,
+} WaiterState;
+
+/// @brief Used for expressing the outcome of
+/// claiming a declared write set (see tm_begin_declared).
+typedef enum _ClaimResult
+{
+  /// @brief Every declared word is ours.
+  CLAIMED,
+  /// @brief A word is claimed or accessed in this
+  /// epoch, the transaction waits for the next one.
+  CLAIM_CONFLICT,
+  /// @brief A range no longer lies within a
+  /// segment, the transaction cannot begin.
+  CLAIM_INVALID,
+} ClaimResult;
+
+/// @brief Default number of bytes of address space reserved
+/// for the data of the segments of one region. The same
+/// amount is reserved for their shadow copies.
+#ifndef ARENA_CAPACITY
+#define ARENA_CAPACITY ((size_t)1 << 36)
+#endif
+
+/// @brief Number of epochs a mapped segment must go without
+/// being accessed by read-write transactions before its shadow
+/// copy and control words are given back to the kernel.
+#ifndef SHADOW_RECLAIM_EPOCHS
+#define SHADOW_RECLAIM_EPOCHS 64
+#endif
+
+/// @brief Number of bytes the redo log of a durable region
+/// may grow to before the region's file is synced and the
+/// log emptied.
+#ifndef LOG_CHECKPOINT_BYTES
+#define LOG_CHECKPOINT_BYTES ((size_t)64 << 20)
+#endif
+
+/// @brief Set on the stamp of a page while the page is written to
+/// the checkpoint being taken, by its writer or by a committer
+/// preserving its pre-image (see tm_checkpoint).
+#define STAMP_BUSY ((unsigned long int)1 << 63)
+
+/// @brief Set on the domains a tracked transaction is counted in
+/// once it ended, so that it is committed rather than rolled back
+/// should its process die (see Reap).
+#define TRACKED_ENDED (1u << 31)
+
 /// @brief Represents a segment of memory in the STM.
 typedef struct _Segment
 {
-  /// @brief Points to the actual data
-  /// [v1, v2, controls].
-  void *data;
+  /// @brief Offset of the data from the start
+  /// of the region's data area.
+  size_t offset;
   /// @brief Size of the data stored in 
   /// this segment (v1 and v2).
   size_t size;
@@ -64,6 +192,18 @@ typedef struct _Segment
   /// @brief Stores whether this segment 
   /// was added or removed in this epoch. <---
   atomic_int status;
+  /// @brief Whether any control word was
+  /// set in this segment in this epoch.
+  atomic_bool touched;
+  /// @brief Last epoch in which read-write
+  /// transactions accessed this segment.
+  unsigned long int last_access;
+  /// @brief Whether the shadow copy and control
+  /// words may currently hold memory.
+  bool resident;
+  /// @brief Domain the segment belongs to plus one,
+  /// 0 while the slot is unused or being set up.
+  atomic_uint domain;
 } Segment;
 
 /// @brief The goal of the Batcher is to artificially create 
@@ -90,25 +230,234 @@ typedef struct _Batcher
   /// @brief Number of write transactions that
   /// entered in the batcher in the current epoch.
   atomic_ulong n_write_entered;
+  /// @brief Bumped when the turn is given away while threads
+  /// of a coordinated region are parked waiting for it, also
+  /// the futex they sleep on.
+  atomic_int turn_generation;
+  /// @brief Number of threads parked waiting for the turn.
+  atomic_int n_turn_parked;
+  /// @brief Continuations of the transactions waiting
+  /// for the end of the current epoch, only accessed
+  /// holding the turn (see tm_begin_async).
+  tm_resume_t *resumes;
+  /// @brief Process holding the turn of a batcher in shared memory,
+  /// 0 when free. Such turns are not handed out in order, so that
+  /// the one of a dead process can be taken over.
+  atomic_int holder;
+  /// @brief Whether the holder is changing the counters, set
+  /// back to the ones below should it die meanwhile
+  atomic_bool holding;
+  /// @brief Counters as the holder found them
+  unsigned long int held_counter;
+  unsigned long int held_entered;
+  unsigned long int held_write_slots;
+  unsigned long int held_write_entered;
+  /// @brief Attachment and tracked transaction the holder is
+  /// entering or leaving the batcher, -1 for none
+  int held_attachment;
+  size_t held_entry;
+  /// @brief Domains the transaction is counted in once done,
+  /// stored last by the holder
+  unsigned int held_domains;
 } Batcher;
 
-/// @brief Represents a region in the
-/// software transactional memory
+/// @brief Redo log of a durable region (see tm_create_durable),
+/// holding one record per committed epoch since the last time the
+/// region's file was synced. Only meaningful in the process that
+/// opened the region.
+typedef struct _RedoLog
+{
+  /// @brief Log file, -1 when the region is not durable
+  int fd;
+  /// @brief Length of the log file (bytes)
+  size_t size;
+  /// @brief Record being built for the epoch
+  char *buffer;
+  /// @brief Length of the record being built (bytes)
+  size_t length;
+  /// @brief Capacity of the buffer (bytes)
+  size_t capacity;
+} RedoLog;
+
+/// @brief Change feed of a region (see tm_feed_start), holding
+/// the writes of the last committed epochs. Only meaningful in
+/// the process that started it.
+typedef struct _ChangeFeed
+{
+  /// @brief Ring the records are published to, NULL when none
+  char *ring;
+  /// @brief Length of the ring (bytes)
+  size_t ring_capacity;
+  /// @brief Position right after the last record published
+  atomic_size_t head;
+  /// @brief Position right after the record being published
+  atomic_size_t writing;
+  /// @brief File descriptor the records are written to, -1 when none
+  int sink;
+  /// @brief Records of the epoch being committed
+  char *buffer;
+  /// @brief Length of the records of the epoch (bytes)
+  size_t length;
+  /// @brief Capacity of the buffer (bytes)
+  size_t buffer_capacity;
+} ChangeFeed;
+
+/// @brief Thread waiting for a range of a region to be
+/// written (see tm_wait_change).
+typedef struct _Waiter
+{
+  /// @brief WaiterState, also the futex the thread sleeps on
+  atomic_int state;
+  /// @brief Offset of the range from the start of the data area
+  size_t start;
+  /// @brief Offset right after the range
+  size_t end;
+} Waiter;
+
+/// @brief Process attached to a region in shared memory (see
+/// tm_create_shared), with the transactions it has running so
+/// that others can roll them back should it die.
+typedef struct _Attachment
+{
+  /// @brief Process, 0 when the slot is free and
+  /// negated while its transactions are rolled back
+  atomic_int pid;
+  /// @brief First identifier of each running transaction,
+  /// NO_OWNER for unused entries and RM_OWNER for those of
+  /// transactions still entering
+  atomic_tx tx[MAX_ATTACHED_TX];
+  /// @brief Domains each running transaction is counted in
+  atomic_uint entered[MAX_ATTACHED_TX];
+  /// @brief Number of identifiers reserved by
+  /// the admission of each running transaction
+  atomic_ulong n_tx[MAX_ATTACHED_TX];
+  /// @brief Checkpoint file opened by the process
+  /// to preserve pages, only meaningful to it
+  int checkpoint_fd;
+  /// @brief Checkpoint the file belongs to, 0 for none
+  unsigned long int checkpoint_id;
+} Attachment;
+
+/// @brief Represents a region in the software transactional
+/// memory. The region lives at the start of a single reserved
+/// arena laid out as [region, segments, page map, page stamps,
+/// data, shadow copies, controls], all located by offsets from
+/// the region.
+/// Persistent regions map everything up to the end of the data
+/// area from a file, the rest is never persisted.
 typedef struct _Region
 {
+  /// @brief REGION_MAGIC once the region
+  /// has been fully initialized
+  unsigned long int magic;
   /// @brief User requested alignment 
   /// of the memory segments (bytes)
   size_t align;
-  /// @brief Batcher for this memory region
-  Batcher batcher;
-  /// @brief Array of segments in this memory region
-  Segment *segments;
+  /// @brief Batcher of each domain of the region,
+  /// transactions of the first domain only by default
+  Batcher domains[MAX_DOMAINS];
+  /// @brief Number of epochs committed by all the
+  /// domains, the one of the region
+  atomic_ulong epoch;
+  /// @brief Process committing the epoch of a domain,
+  /// 0 when none, commits of different domains not overlapping
+  atomic_int committing;
+  /// @brief Domain being committed
+  unsigned int commit_domain;
+  /// @brief Epoch of the region when the commit started,
+  /// only moving along with it once the domain's epoch did
+  unsigned long int commit_epoch;
+  /// @brief Whether transactions were started in other
+  /// domains than the first one (see tm_begin_domains)
+  atomic_bool sharded;
+  /// @brief Number of transactions
+  /// spanning several domains
+  atomic_ulong n_cross;
   /// @brief True alignment of the memory 
   /// segments (bytes)
   size_t true_align;
   /// @brief Maximum index of any allocated
   /// memory segment in the region
   atomic_ulong index;
+  /// @brief Length of the whole arena (bytes)
+  size_t length;
+  /// @brief Size of the data area, and of the
+  /// shadow area right after it (bytes)
+  size_t capacity;
+  /// @brief Granularity at which segments
+  /// are carved out of the data area (bytes)
+  size_t page_size;
+  /// @brief Offset of the array of segments
+  size_t segments_offset;
+  /// @brief Offset of the page map, holding for each
+  /// page of the data area the index of the segment
+  /// owning it plus one, or zero when unused
+  size_t map_offset;
+  /// @brief Offset of the page stamps, holding for
+  /// each page of the data area the last epoch
+  /// that wrote to it
+  size_t stamps_offset;
+  /// @brief Offset of the data area
+  size_t data_offset;
+  /// @brief Offset of the control words, one
+  /// per word of the data area
+  size_t controls_offset;
+  /// @brief Offset of the first unused
+  /// byte of the data area
+  atomic_size_t top;
+  /// @brief Whether the region and the data area
+  /// are mapped from a file (see tm_create_file)
+  bool persistent;
+  /// @brief Epoch whose writes are being applied to the
+  /// data area, only set when its record could not be logged
+  unsigned long int applying_epoch;
+  /// @brief Last such epoch whose writes
+  /// have all reached the file
+  unsigned long int applied_epoch;
+  /// @brief Redo log, when durable
+  RedoLog log;
+  /// @brief Change feed, when started
+  ChangeFeed feed;
+  /// @brief Number of threads waiting for changes
+  atomic_int n_waiters;
+  /// @brief Threads waiting for changes
+  Waiter waiters[MAX_WAITERS];
+  /// @brief Whether the epochs of the region are committed and
+  /// waited for through the process-wide coordinator (see tm_coordinate)
+  bool coordinated;
+  /// @brief Process writing the last checkpoint
+  /// started by this process, 0 when none
+  pid_t checkpoint;
+  /// @brief Whether a checkpoint of the region, persistent or
+  /// shared, is being written: committers preserve the pages
+  /// it has not written yet before changing them
+  atomic_bool checkpointing;
+  /// @brief Whether preserving a page failed
+  atomic_bool checkpoint_failed;
+  /// @brief Process writing it
+  pid_t checkpoint_writer;
+  /// @brief Epoch the checkpoint being written is taken at,
+  /// pages stamped after it being preserved already
+  unsigned long int checkpoint_epoch;
+  /// @brief Number of checkpoints started while
+  /// checkpointing, telling the files apart
+  unsigned long int checkpoint_id;
+  /// @brief Absolute path the checkpoint is written to
+  char checkpoint_path[PATH_MAX];
+  /// @brief Checkpoint file opened by this process to preserve
+  /// pages, the ones of shared regions being in their attachments
+  int checkpoint_fd;
+  /// @brief Checkpoint the file belongs to, 0 for none
+  unsigned long int checkpoint_fd_id;
+  /// @brief Whether the whole arena is mapped from a shared
+  /// memory object by every attached process (see tm_create_shared)
+  bool shared;
+  /// @brief Name of the shared memory object
+  char name[NAME_MAX + 1];
+  /// @brief Number of attached processes
+  atomic_int n_attached;
+  /// @brief Attached processes
+  Attachment attachments[MAX_ATTACHMENTS];
 } Region;
 
 #endif
\ No newline at end of file
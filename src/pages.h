@@ -0,0 +1,198 @@
+#ifndef _PAGES_H_
+#define _PAGES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/// @brief Size of the huge pages used when
+/// USE_HUGE_PAGES or USE_MAP_HUGETLB is defined.
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/**
+ * @brief Rounds a value up to a multiple of a power of two.
+ * @param value Value to round
+ * @param granule Power of two
+ * @return Rounded value
+ */
+static inline size_t RoundUp(size_t value, size_t granule)
+{
+  return (value + granule - 1) & ~(granule - 1);
+}
+
+/**
+ * @brief Reserves a range of virtual addresses without committing any memory.
+ * Pages are inaccessible until committed with CommitPages.
+ * @param length Length of the range (bytes)
+ * @param alignment Alignment of the start of the range (power of two)
+ * @return Start of the range, NULL on failure
+ */
+static inline void *ReservePages(size_t length, size_t alignment)
+{
+  // Over-reserving to carve out an aligned range
+  char *raw = mmap(NULL, length + alignment, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (raw == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  char *aligned = (char *)RoundUp((uintptr_t)raw, alignment);
+  if (aligned != raw)
+  {
+    munmap(raw, aligned - raw);
+  }
+  munmap(aligned + length, raw + alignment - aligned);
+  return aligned;
+}
+
+/**
+ * @brief Makes the pages overlapping a reserved range accessible. They read
+ * as zeros and only hold memory once written. When configured, whole huge
+ * pages within the range are taken from the huge page pool (USE_MAP_HUGETLB)
+ * or advised to use transparent huge pages (USE_HUGE_PAGES), falling back to
+ * regular pages otherwise.
+ * @param start Start of the range
+ * @param length Length of the range (bytes)
+ * @param huge Whether huge pages may back the range
+ * @return Whether the range is now accessible
+ */
+static inline bool CommitPages(void *start, size_t length, bool huge)
+{
+  uintptr_t page = (uintptr_t)getpagesize();
+  uintptr_t from = (uintptr_t)start & ~(page - 1);
+  uintptr_t to = RoundUp((uintptr_t)start + length, page);
+
+#if defined(USE_HUGE_PAGES) || defined(USE_MAP_HUGETLB)
+  uintptr_t huge_from = RoundUp(from, HUGE_PAGE_SIZE);
+  uintptr_t huge_to = to & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+  if (huge && huge_from < huge_to)
+  {
+#if defined(USE_MAP_HUGETLB) && defined(MAP_HUGETLB)
+    // Reserved huge pages, only when the pool has enough of them
+    if (mmap((void *)huge_from, huge_to - huge_from, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0) != MAP_FAILED)
+    {
+      return (huge_from == from || mprotect((void *)from, huge_from - from, PROT_READ | PROT_WRITE) == 0) && (huge_to == to || mprotect((void *)huge_to, to - huge_to, PROT_READ | PROT_WRITE) == 0);
+    }
+#endif
+#if defined(MADV_HUGEPAGE)
+    // Advice is best effort, the range stays usable either way
+    madvise((void *)huge_from, huge_to - huge_from, MADV_HUGEPAGE);
+#endif
+  }
+#else
+  (void)huge;
+#endif
+
+  return mprotect((void *)from, to - from, PROT_READ | PROT_WRITE) == 0;
+}
+
+/**
+ * @brief Gives the pages entirely within a range back to the kernel,
+ * they read as zeros and hold no memory until written again.
+ * @param start Start of the range
+ * @param length Length of the range (bytes)
+ */
+static inline void ReleasePages(void *start, size_t length)
+{
+  uintptr_t page = (uintptr_t)getpagesize();
+  uintptr_t from = RoundUp((uintptr_t)start, page);
+  uintptr_t to = ((uintptr_t)start + length) & ~(page - 1);
+  if (from < to)
+  {
+    madvise((void *)from, to - from, MADV_DONTNEED);
+  }
+}
+
+/**
+ * @brief Returns the pages entirely within a committed range to the
+ * reserved state, releasing their memory.
+ * @param start Start of the range
+ * @param length Length of the range (bytes)
+ */
+static inline void DecommitPages(void *start, size_t length)
+{
+  uintptr_t page = (uintptr_t)getpagesize();
+  uintptr_t from = RoundUp((uintptr_t)start, page);
+  uintptr_t to = ((uintptr_t)start + length) & ~(page - 1);
+  if (from < to)
+  {
+    // Remapping also drops huge pool pages, unlike madvise
+    mmap((void *)from, to - from, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+  }
+}
+
+/**
+ * @brief Zeroes the pages entirely within a range of a shared file mapping,
+ * giving the blocks back to the file system when it supports it.
+ * @param start Start of the range
+ * @param length Length of the range (bytes)
+ */
+static inline void ClearPages(void *start, size_t length)
+{
+  uintptr_t page = (uintptr_t)getpagesize();
+  uintptr_t from = RoundUp((uintptr_t)start, page);
+  uintptr_t to = ((uintptr_t)start + length) & ~(page - 1);
+  if (from < to && madvise((void *)from, to - from, MADV_REMOVE) != 0)
+  {
+    // No hole punching, writing zeros instead
+    memset((void *)from, 0, to - from);
+  }
+}
+
+/**
+ * @brief Measures how much of a range is currently backed by huge pages,
+ * as reported by the kernel in /proc/self/smaps. Kernel areas spanning
+ * more than the range are accounted for proportionally.
+ * @param data Start of the range
+ * @param length Length of the range (bytes)
+ * @return Number of bytes backed by huge pages
+ */
+static inline size_t ResidentHugeBytes(void const *data, size_t length)
+{
+  FILE *smaps = fopen("/proc/self/smaps", "r");
+  if (smaps == NULL)
+  {
+    return 0;
+  }
+
+  uintptr_t start = (uintptr_t)data, end = start + length;
+  uintptr_t area_start = 0, area_end = 0;
+  size_t huge = 0;
+
+  char line[256];
+  while (fgets(line, sizeof(line), smaps) != NULL)
+  {
+    // Each area starts with its address range
+    uintptr_t from, to;
+    if (sscanf(line, "%lx-%lx ", &from, &to) == 2)
+    {
+      area_start = from;
+      area_end = to;
+      continue;
+    }
+
+    // Transparent huge pages, or pages from the huge page pool
+    size_t kb;
+    if (sscanf(line, "AnonHugePages: %zu kB", &kb) != 1 && sscanf(line, "Private_Hugetlb: %zu kB", &kb) != 1 && sscanf(line, "Shared_Hugetlb: %zu kB", &kb) != 1)
+    {
+      continue;
+    }
+    if (kb == 0 || area_end <= start || area_start >= end)
+    {
+      continue;
+    }
+
+    uintptr_t overlap_start = area_start > start ? area_start : start;
+    uintptr_t overlap_end = area_end < end ? area_end : end;
+    huge += (size_t)((double)(kb << 10) * (overlap_end - overlap_start) / (area_end - area_start));
+  }
+
+  fclose(smaps);
+  return huge;
+}
+
+#endif
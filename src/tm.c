@@ -4,8 +4,17 @@
 #error Current C11 compiler does not support atomic operations
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
 #include "memory.h"
 #include "basic_operations.h"
+#include "checkpoint.h"
+
+Coordinator coordinator;
 
 /** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
  * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
@@ -14,58 +23,301 @@
  **/
 shared_t tm_create(size_t size, size_t align)
 {
-  size_t true_align = align < sizeof(void *) ? sizeof(void *) : align;
+  // Reserving the arena, shrinking it while the address space runs short
+  Region layout;
+  Region *region = NULL;
+  for (size_t capacity = RoundUp(ARENA_CAPACITY > (size << 1) ? ARENA_CAPACITY : (size << 1), HUGE_PAGE_SIZE); region == NULL; capacity >>= 1)
+  {
+    if (capacity < size)
+    {
+      return invalid_shared;
+    }
+    LayoutRegion(&layout, align, capacity);
+    region = ReservePages(layout.length, ArenaAlignment(&layout));
+  }
 
-  // Allocating Memory for the region
-  Region *region = malloc(sizeof(Region));
-  if (region == NULL)
+  // Region, segments and page map are plain memory
+  if (!CommitPages(region, layout.data_offset, false))
   {
+    munmap(region, layout.length);
     return invalid_shared;
   }
 
   // Initializing Region
-  region->align = align;
-  region->true_align = true_align;
-  atomic_store(&(region->index), 1);
-
-  // Initializing region->batcher
-  atomic_store(&(region->batcher.turn), 0);
-  atomic_store(&(region->batcher.last_turn), 0);
-  atomic_store(&(region->batcher.counter), 0);
-  atomic_store(&(region->batcher.n_entered), 0);
-  atomic_store(&(region->batcher.n_write_entered), 0);
-  atomic_store(&(region->batcher.n_write_slots), MAX_WRITE_TX_PER_EPOCH);
-
-  // Allocating space for region->segments
-  region->segments = malloc(getpagesize());
-  if (region->segments == NULL)
-  {
-    free(region);
+  memcpy(region, &layout, sizeof(Region));
+  if (!InitRegion(region, size))
+  {
+    munmap(region, layout.length);
     return invalid_shared;
   }
 
-  // Initializing region->segment
-  memset(region->segments, 0, getpagesize());
+  return region;
+}
 
-  region->segments->size = size;
-  atomic_store(&(region->segments->status), DEFAULT);
-  atomic_store(&(region->segments->owner), NO_OWNER);
+/** Create or reopen a shared memory region persisted in a file, see tm_create_file and tm_create_durable.
+ * @param path   Path of the file holding the region
+ * @param log_fd Redo log of a durable region, -1 otherwise
+ * @param size   Size of the first shared segment of memory (in bytes)
+ * @param align  Alignment (in bytes, must be a power of 2)
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+static shared_t OpenRegion(char const *path, int log_fd, size_t size, size_t align)
+{
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    return invalid_shared;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0)
+  {
+    close(fd);
+    return invalid_shared;
+  }
+
+  // Existing files are laid out as described by their region
+  Region layout;
+  bool existing = status.st_size != 0;
+  if (existing)
+  {
+    if (pread(fd, &layout, sizeof(Region), 0) != sizeof(Region) || layout.magic != REGION_MAGIC || layout.align != align || layout.page_size != (size_t)getpagesize() || (size_t)status.st_size < layout.data_offset + layout.capacity)
+    {
+      close(fd);
+      return invalid_shared;
+    }
+  }
+  else
+  {
+    // Data area is sparse, only the carved part of it holds blocks
+    LayoutRegion(&layout, align, RoundUp(ARENA_CAPACITY > (size << 1) ? ARENA_CAPACITY : (size << 1), HUGE_PAGE_SIZE));
+    layout.persistent = true;
+    if (ftruncate(fd, layout.data_offset + layout.capacity) != 0)
+    {
+      close(fd);
+      return invalid_shared;
+    }
+  }
 
-  // Allocating Space for region->segment->data
-  size_t control_size = (size / true_align) * sizeof(tx_t);
-  if (posix_memalign(&(region->segments->data), true_align, (size << 1) + control_size) != 0)
+  // Mapping everything up to the end of the data area from the file
+  Region *region = ReservePages(layout.length, ArenaAlignment(&layout));
+  if (region == NULL || mmap(region, layout.data_offset + layout.capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
   {
-    free(region->segments);
-    free(region);
+    if (region != NULL)
+    {
+      munmap(region, layout.length);
+    }
+    close(fd);
     return invalid_shared;
   }
+  close(fd);
 
-  // Initializing region->segment->data
-  memset(region->segments->data, 0, (size << 1) + control_size);
+  if (existing)
+  {
+    // Log, feed, waiters and checkpoint of the previous process are of no use
+    memset(&(region->log), 0, sizeof(RedoLog));
+    region->log.fd = log_fd;
+    memset(&(region->feed), 0, sizeof(ChangeFeed));
+    region->feed.sink = -1;
+    atomic_store(&(region->n_waiters), 0);
+    memset(region->waiters, 0, sizeof(region->waiters));
+    region->coordinated = false;
+    region->checkpoint = 0;
+    atomic_store(&(region->checkpointing), false);
+    region->checkpoint_writer = 0;
+    region->checkpoint_fd_id = 0;
+
+    // Replaying the epochs that only reached the log
+    if (log_fd >= 0)
+    {
+      unsigned long int epoch = LogReplay(&(region->log), (char *)region, layout.data_offset + layout.capacity);
+      if (epoch > atomic_load(&(region->epoch)))
+      {
+        atomic_store(&(region->epoch), epoch);
+      }
+    }
+
+    // Restoring the last committed epoch
+    if (Segments(region)->size != size || !RecoverRegion(region))
+    {
+      free(region->log.buffer);
+      munmap(region, layout.length);
+      return invalid_shared;
+    }
+
+    // Starting over with an empty log
+    if (log_fd >= 0)
+    {
+      Checkpoint(region);
+    }
+    return region;
+  }
+
+  // Initializing Region
+  memcpy(region, &layout, sizeof(Region));
+  region->log.fd = log_fd;
+  if ((log_fd >= 0 && ftruncate(log_fd, 0) != 0) || !InitRegion(region, size))
+  {
+    munmap(region, layout.length);
+    return invalid_shared;
+  }
 
   return region;
 }
 
+/** Create or reopen a durable shared memory region persisted in a file. Each epoch is made durable by appending its writes to a redo log with a single fdatasync before it commits, the region's file itself only being synced once the log grows large. Reopening replays the log.
+ * @param path     Path of the file holding the region
+ * @param log_path Path of the redo log
+ * @param size     Size of the first shared segment of memory (in bytes), must match the one of an existing file
+ * @param align    Alignment (in bytes, must be a power of 2), must match the one of an existing file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_create_durable(char const *path, char const *log_path, size_t size, size_t align)
+{
+  int log_fd = open(log_path, O_RDWR | O_CREAT, 0644);
+  if (log_fd < 0)
+  {
+    return invalid_shared;
+  }
+
+  shared_t shared = OpenRegion(path, log_fd, size, align);
+  if (shared == invalid_shared)
+  {
+    close(log_fd);
+  }
+  return shared;
+}
+
+/** Create or reopen a shared memory region persisted in a file. A new file gets one first non-free-able allocated segment of the requested size and alignment, an existing one is restored as of its last committed epoch. Each epoch is journaled to '<path>-journal' with a single fdatasync before any of its writes can reach the file, so that one interrupted while applied is replayed on reopen, as the log of tm_create_durable.
+ * @param path  Path of the file holding the region
+ * @param size  Size of the first shared segment of memory (in bytes), must match the one of an existing file
+ * @param align Alignment (in bytes, must be a power of 2), must match the one of an existing file
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure or when the file holds an epoch that could not be journaled and was interrupted
+ **/
+shared_t tm_create_file(char const *path, size_t size, size_t align)
+{
+  char journal[PATH_MAX];
+  if (snprintf(journal, sizeof(journal), "%s-journal", path) >= (int)sizeof(journal))
+  {
+    return invalid_shared;
+  }
+  return tm_create_durable(path, journal, size, align);
+}
+
+/** Create or attach to a shared memory region in a POSIX shared memory object, so that several processes can run transactions on it. The first process creates it with one first non-free-able allocated segment of the requested size and alignment. The batcher, segment table and control words are shared too, and segments are located by offsets, so each process may map the region at a different address. Should an attached process die, the transactions it had running are rolled back by the others, and the turn of a batcher or the commit of an epoch it died in are taken over.
+ * @param name  Name of the shared memory object, as given to shm_open
+ * @param size  Size of the first shared segment of memory (in bytes), must match the one of an existing object
+ * @param align Alignment (in bytes, must be a power of 2), must match the one of an existing object
+ * @return Opaque shared memory region handle, 'invalid_shared' on failure
+ **/
+shared_t tm_create_shared(char const *name, size_t size, size_t align)
+{
+  if (strlen(name) > NAME_MAX)
+  {
+    return invalid_shared;
+  }
+
+  // First process creates the object
+  bool existing = false;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST)
+  {
+    existing = true;
+    fd = shm_open(name, O_RDWR, 0600);
+  }
+  if (fd < 0)
+  {
+    return invalid_shared;
+  }
+
+  Region layout;
+  if (existing)
+  {
+    // Waiting for the creator to initialize the region
+    size_t spins = 0;
+    while (pread(fd, &layout, sizeof(Region), 0) != sizeof(Region) || layout.magic != REGION_MAGIC)
+    {
+      if (++spins == REAP_SPINS << 4)
+      {
+        close(fd);
+        return invalid_shared;
+      }
+      relinquish_cpu();
+    }
+    if (!layout.shared || layout.align != align || layout.page_size != (size_t)getpagesize())
+    {
+      close(fd);
+      return invalid_shared;
+    }
+  }
+  else
+  {
+    // Object is sparse, only the pages written hold memory
+    LayoutRegion(&layout, align, RoundUp(ARENA_CAPACITY > (size << 1) ? ARENA_CAPACITY : (size << 1), HUGE_PAGE_SIZE));
+    layout.shared = true;
+    strcpy(layout.name, name);
+    if (ftruncate(fd, layout.length) != 0)
+    {
+      close(fd);
+      shm_unlink(name);
+      return invalid_shared;
+    }
+  }
+
+  // Mapping the whole arena from the object
+  Region *region = ReservePages(layout.length, ArenaAlignment(&layout));
+  if (region == NULL || mmap(region, layout.length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+  {
+    if (region != NULL)
+    {
+      munmap(region, layout.length);
+    }
+    close(fd);
+    if (!existing)
+    {
+      shm_unlink(name);
+    }
+    return invalid_shared;
+  }
+  close(fd);
+
+  // Initializing Region
+  if (!existing)
+  {
+    memcpy(region, &layout, sizeof(Region));
+    if (!InitRegion(region, size))
+    {
+      munmap(region, layout.length);
+      shm_unlink(name);
+      return invalid_shared;
+    }
+  }
+  else if (Segments(region)->size != size)
+  {
+    munmap(region, layout.length);
+    return invalid_shared;
+  }
+
+  // Taking a slot, those of dead processes are freed first
+  for (size_t attempt = 0; attempt < 2; ++attempt)
+  {
+    for (size_t i = 0; i < MAX_ATTACHMENTS; ++i)
+    {
+      int expected = 0;
+      if (atomic_compare_exchange_strong(&(region->attachments[i].pid), &expected, getpid()))
+      {
+        region->attachments[i].checkpoint_id = 0;
+        atomic_fetch_add(&(region->n_attached), 1);
+        return region;
+      }
+    }
+    Reap(region);
+  }
+
+  munmap(region, layout.length);
+  return invalid_shared;
+}
+
 /** Destroy (i.e. clean-up + free) a given shared memory region.
  * @param shared Shared memory region to destroy, with no running transaction
  **/
@@ -73,28 +325,56 @@ void tm_destroy(shared_t shared)
 {
   Region *region = shared;
 
-  // Deallocating all the segments in the region
-  for (size_t i = region->index; i < region->index; --i)
+  // Checkpoint file is complete once its writer exits
+  if (region->checkpoint != 0)
+  {
+    waitpid(region->checkpoint, NULL, 0);
+  }
+
+  // Checkpoint file this process preserved pages to
+  Attachment *attachment = Attached(region);
+  if (attachment != NULL ? attachment->checkpoint_id != 0 : region->checkpoint_fd_id != 0)
   {
-    free(region->segments[i].data);
+    close(attachment != NULL ? attachment->checkpoint_fd : region->checkpoint_fd);
   }
-  free(region->segments);
 
-  // Deallocating region itself
-  free(region);
+  // Last process to detach removes the shared memory object, dead ones do not count
+  if (attachment != NULL)
+  {
+    Reap(region);
+    atomic_store(&(attachment->pid), 0);
+    if (atomic_fetch_add(&(region->n_attached), -1) == 1)
+    {
+      shm_unlink(region->name);
+    }
+  }
+
+  // Redo log is private to this process
+  if (region->log.fd >= 0)
+  {
+    close(region->log.fd);
+    free(region->log.buffer);
+  }
+
+  // Feed too, its sink belonging to the caller
+  free(region->feed.ring);
+  free(region->feed.buffer);
+
+  // Region and all its segments live in the same arena
+  munmap(region, region->length);
 }
 
 /** [thread-safe] Return the start address of the first allocated segment in the shared memory region.
  * @param shared Shared memory region to query
  * @return Start address of the first allocated segment
  **/
-void *tm_start(shared_t shared) { return ((Region *)shared)->segments->data; }
+void *tm_start(shared_t shared) { return SegmentData((Region *)shared, Segments((Region *)shared)); }
 
 /** [thread-safe] Return the size (in bytes) of the first allocated segment of the shared memory region.
  * @param shared Shared memory region to query
  * @return First allocated segment size
  **/
-size_t tm_size(shared_t shared) { return ((Region *)shared)->segments->size; }
+size_t tm_size(shared_t shared) { return Segments((Region *)shared)->size; }
 
 /** [thread-safe] Return the alignment (in bytes) of the memory accesses on the given shared memory region.
  * @param shared Shared memory region to query
@@ -107,7 +387,88 @@ size_t tm_align(shared_t shared) { return ((Region *)shared)->true_align; }
  * @param is_ro  Whether the transaction is read-only
  * @return Opaque transaction ID, 'invalid_tx' on failure
  **/
-tx_t tm_begin(shared_t shared, bool is_ro) { return Enter((Region *)shared, is_ro); }
+tx_t tm_begin(shared_t shared, bool is_ro) { return Begin((Region *)shared, 1, is_ro, 1, NULL, 0); }
+
+/** [thread-safe] Begin a new transaction on some domains of the given shared memory region. Each domain has its own batcher, so transactions confined to different domains never wait for one another. Transactions only access segments of their domains, and allocate in the first of them. Those spanning several domains hold back the epochs of all of them, and always run as read-write transactions.
+ * @param shared  Shared memory region to start a transaction on
+ * @param is_ro   Whether the transaction is read-only
+ * @param domains Set of domains of the transaction, bit 'd' standing for domain 'd' (up to 8 domains), 1 being the domain of tm_begin
+ * @return Opaque transaction ID, 'invalid_tx' on failure
+ **/
+tx_t tm_begin_domains(shared_t shared, bool is_ro, unsigned int domains)
+{
+  Region *region = (Region *)shared;
+  if (domains == 0 || domains >= (1u << MAX_DOMAINS))
+  {
+    return invalid_tx;
+  }
+
+  // Reads of transactions of the first domain are checked from now on
+  if (domains != 1 && !atomic_load_explicit(&(region->sharded), memory_order_relaxed))
+  {
+    atomic_store(&(region->sharded), true);
+  }
+
+  return Begin(region, domains, is_ro, 1, NULL, 0);
+}
+
+/** [thread-safe] Begin a new read-write transaction whose write set is declared up front.
+ * @param shared   Shared memory region to start a transaction on
+ * @param ranges   Address ranges the transaction will write, each within one segment and aligned
+ * @param n_ranges Number of declared ranges
+ * @return Opaque transaction ID, 'invalid_tx' on failure, including when a segment of the ranges is freed before the transaction is admitted
+ **/
+tx_t tm_begin_declared(shared_t shared, tm_range_t const *ranges, size_t n_ranges)
+{
+  Region *region = (Region *)shared;
+
+  // Every range must lie within a single segment, checked again once admitted
+  for (size_t r = 0; r < n_ranges; ++r)
+  {
+    if (!Declared(region, ranges + r))
+    {
+      return invalid_tx;
+    }
+  }
+
+  return Begin(region, 1, false, 1, ranges, n_ranges);
+}
+
+/** [thread-safe] Begin a new transaction on the first domain of the given shared memory region without waiting for an epoch. When a read-write transaction cannot enter the current epoch, the continuation is registered instead and called by the thread committing that epoch, the transaction being to begin again then. Aborts of the transactions begun this way do not wait for the epoch either. Regions in shared memory wait as tm_begin does, their epochs being committed by other processes.
+ * @param shared Shared memory region to start a transaction on
+ * @param is_ro  Whether the transaction is read-only
+ * @param resume Continuation, called once the current epoch is over when 'invalid_tx' is returned
+ * @return Opaque transaction ID, 'invalid_tx' when waiting for the epoch
+ **/
+tx_t tm_begin_async(shared_t shared, bool is_ro, tm_resume_t *resume)
+{
+  Region *region = (Region *)shared;
+  if (region->shared)
+  {
+    return Begin(region, 1, is_ro, 1, NULL, 0);
+  }
+
+  tx_t tx = Enter(region, 0, is_ro, 1, NULL, 0, resume, NULL, MAX_ATTACHED_TX);
+  return is_ro || tx == invalid_tx ? tx : tx | ASYNC_TX;
+}
+
+/** [thread-safe] End the given transaction without waiting for the epoch to commit it. When its epoch is not over yet, the continuation is registered and called by the thread committing the epoch. Transactions of several domains and of regions in shared memory wait as with tm_end.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to end
+ * @param resume Continuation, called once the transaction committed when 'false' is returned
+ * @return Whether the whole transaction committed already
+ **/
+bool tm_end_async(shared_t shared, tx_t tx, tm_resume_t *resume)
+{
+  Region *region = (Region *)shared;
+  if (region->shared || Domains(tx) != 1)
+  {
+    return Leave(region, tx);
+  }
+
+  unsigned long int epoch;
+  return !Depart(region, 0, tx, NULL, MAX_ATTACHED_TX, &epoch, resume);
+}
 
 /** [thread-safe] End the given transaction.
  * @param shared Shared memory region associated with the transaction
@@ -126,25 +487,39 @@ bool tm_end(shared_t shared, tx_t tx) { return Leave((Region *)shared, tx); }
  **/
 bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
 {
+  Region *region = (Region *)shared;
+
   // If it's a read only transaction we only need to copy the contents of the memory
-  if (tx == RO_OWNER)
+  if (ReadOnly(tx))
   {
+    // Segments of other domains are only looked for once there are some
+    if (atomic_load_explicit(&(region->sharded), memory_order_relaxed))
+    {
+      Segment *segment = LookupSegment(region, source);
+      if (segment == NULL || !Within(segment, tx))
+      {
+        Undo(region, tx);
+        return false;
+      }
+    }
+
     memcpy(target, source, size);
     return true;
   }
 
-  // Looking up segment
-  Region *region = (Region *)shared;
+  // Looking up segment, which must belong to a domain of the transaction
   Segment *segment = LookupSegment(region, source);
-  if (segment == NULL)
+  if (segment == NULL || !Within(segment, tx))
   {
     Undo(region, tx);
     return false;
   }
 
   // Getting control words
-  size_t base_index = ((char *)source - (char *)segment->data) / region->align;
-  atomic_tx *controls = ((atomic_tx *)((char *)segment->data + (segment->size << 1))) + base_index;
+  atomic_tx *controls = Controls(region, source);
+
+  // Segment is accessed in this epoch
+  Touch(segment);
 
   // Reading the content of the memory
   size_t max = size / region->align;
@@ -154,12 +529,12 @@ bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *ta
     if (tx == atomic_load(controls + i))
     {
       // We are the owner
-      memcpy(((char *)target) + i * region->true_align, ((char *)source) + i * region->true_align + segment->size, region->true_align);
+      memcpy(((char *)target) + i * region->align, (char *)Shadow(region, source) + i * region->align, region->align);
     }
     else if (atomic_compare_exchange_strong(controls + i, &expected, -tx) || expected == -tx || expected == RO_OWNER || (expected > RO_OWNER && atomic_compare_exchange_strong(controls + i, &expected, RO_OWNER)))
     {
       // We have previously read it or the word has not owner yet
-      memcpy(((char *)target) + i * region->true_align, ((char *)source) + i * region->true_align, region->true_align);
+      memcpy(((char *)target) + i * region->align, ((char *)source) + i * region->align, region->align);
     }
     else
     {
@@ -185,9 +560,9 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *t
 {
   Region *region = (Region *)shared;
 
-  // Looking up segment
+  // Looking up segment, which must belong to a domain of the transaction
   Segment *segment = LookupSegment(region, target);
-  if (segment == NULL)
+  if (segment == NULL || !Within(segment, tx))
   {
     Undo(region, tx);
     return false;
@@ -201,7 +576,7 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *t
   }
 
   // Copying the contents to the destination
-  memcpy((char *)target + segment->size, source, size);
+  memcpy(Shadow(region, target), source, size);
 
   return true;
 }
@@ -218,25 +593,38 @@ alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target)
   Region *region = (Region *)shared;
 
   // Allocating new segment
-  unsigned long int index = atomic_fetch_add(&(region->index), 1);
-  Segment *segment = region->segments + index;
+  unsigned long int index = atomic_load(&(region->index));
+  do
+  {
+    if (index >= MAX_SEGMENTS)
+    {
+      return nomem_alloc;
+    }
+  } while (!atomic_compare_exchange_weak(&(region->index), &index, index + 1));
+  Segment *segment = Segments(region) + index;
 
-  // Initializing new segment
-  segment->size = size;
+  // Initializing new segment, in the first domain of the transaction
+  unsigned int domain = __builtin_ctz(Domains(tx));
   atomic_store(&(segment->owner), tx);
   atomic_store(&(segment->status), ADDED);
+  segment->size = size;
+  atomic_store(&(segment->touched), false);
+  segment->last_access = atomic_load(&(region->domains[domain].counter));
+  segment->resident = false;
+
+  // Committers of other domains skip the slot until now
+  atomic_store_explicit(&(segment->domain), domain + 1, memory_order_release);
 
-  // Allocating memory for the segment's data + control
-  size_t control_size = segment->size / region->align * sizeof(tx_t);
-  if (posix_memalign(&(segment->data), region->true_align, (size << 1) + control_size) != 0)
+  // Carving the segment's data, shadow and controls out of the arena
+  if (!AllocateData(region, segment, index))
   {
+    // Slot is given back with the epoch
+    FreeData(region, segment);
+    atomic_store(&(segment->owner), RM_OWNER);
     return nomem_alloc;
   }
 
-  // Initializing data and control
-  memset(segment->data, 0, (size << 1) + control_size);
-
-  *target = segment->data;
+  *target = SegmentData(region, segment);
   return success_alloc;
 }
 
@@ -248,9 +636,9 @@ alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target)
  **/
 bool tm_free(shared_t shared, tx_t tx, void *seg)
 {
-  // Looking up segment
+  // Looking up segment, which must belong to a domain of the transaction
   Segment *segment = LookupSegment((Region *)shared, seg);
-  if (segment == NULL)
+  if (segment == NULL || !Within(segment, tx))
   {
     Undo((Region*)shared, tx);
     return false;
@@ -270,3 +658,345 @@ bool tm_free(shared_t shared, tx_t tx, void *seg)
 
   return true;
 }
+
+/** [thread-safe] Run many independent read-write transactions through a single batcher admission.
+ * @param shared    Shared memory region to run the transactions on
+ * @param n         Number of transactions in the batch
+ * @param callbacks Body of each transaction
+ * @param ctxs      Private context passed to each body
+ * @param results   Receives whether each transaction committed
+ * @return Number of transactions that committed, those whose body did not complete in any of the 'MAX_BATCH_ATTEMPTS' admissions being reported as not committed
+ **/
+size_t tm_run_batch(shared_t shared, size_t n, tm_batch_fn const *callbacks, void *const *ctxs, bool *results)
+{
+  Region *region = (Region *)shared;
+
+  memset(results, 0, n * sizeof(bool));
+
+  size_t committed = 0;
+  for (size_t attempt = 0; attempt < MAX_BATCH_ATTEMPTS && committed < n; ++attempt)
+  {
+    // Admitting every pending transaction at once
+    tx_t base = Begin(region, 1, false, n - committed, NULL, 0);
+
+    // Running the pending transactions back to back
+    tx_t next = base;
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (results[i])
+      {
+        continue;
+      }
+
+      tx_t tx = (next++) | BATCH_TX;
+      if (callbacks[i](shared, tx, ctxs[i]))
+      {
+        results[i] = true;
+        ++committed;
+      }
+      else
+      {
+        // Body gave up on its own or was aborted, retried on next admission
+        Rollback(region, tx);
+      }
+    }
+
+    // Committing the whole batch with the epoch
+    Leave(region, base);
+  }
+
+  return committed;
+}
+
+/** [thread-safe] Gather statistics about the given shared memory region.
+ * @param shared Shared memory region to query
+ * @param stats  Receives the statistics
+ **/
+void tm_stats(shared_t shared, tm_stats_t *stats)
+{
+  Region *region = (Region *)shared;
+
+  memset(stats, 0, sizeof(tm_stats_t));
+
+  // For each segment in region
+  for (size_t i = region->index - 1; i < region->index; --i)
+  {
+    Segment *segment = Segments(region) + i;
+    if (segment->size == 0 || atomic_load(&(segment->owner)) == RM_OWNER)
+    {
+      continue;
+    }
+
+    // Shadow copy and control words, unless reclaimed
+    size_t controls = (segment->size / region->align) * sizeof(tx_t);
+    if (segment->resident)
+    {
+      stats->shadow_bytes += segment->size + controls;
+    }
+
+    // Data, shadow and control words committed in the arena
+    size_t length = Footprint(region, segment->size);
+    stats->mapped_bytes += (length << 1) + RoundUp((length / region->align) * sizeof(tx_t), region->page_size);
+  }
+
+  // Data, shadow and control areas lie next to each other
+  stats->huge_bytes = ResidentHugeBytes(Data(region), region->length - region->data_offset);
+}
+
+/** [thread-safe] Start writing a checkpoint of the given shared memory region to a file, which can be reopened with tm_create_file. The checkpoint holds the state at the epoch boundary at which it is taken, and is written in the background by a fork of the process while transactions keep committing. Anonymous regions are copied on write by the fork; file-backed and shared memory regions are shared with it instead, so the epochs committing meanwhile first write the pages they change, as they were at the boundary, to the checkpoint.
+ * @param shared Shared memory region to checkpoint
+ * @param path   Path of the checkpoint, only replaced once it is complete
+ * @return Whether the checkpoint was started, 'false' while the previous one is still being written
+ **/
+bool tm_checkpoint(shared_t shared, char const *path)
+{
+  Region *region = (Region *)shared;
+
+  // One checkpoint at a time
+  if (region->checkpoint != 0)
+  {
+    int status;
+    pid_t done = waitpid(region->checkpoint, &status, WNOHANG);
+    if (done == 0)
+    {
+      return false;
+    }
+
+    // Writer killed before telling committers it is over
+    if (done == region->checkpoint && !WIFEXITED(status))
+    {
+      atomic_store(&(region->checkpointing), false);
+    }
+    region->checkpoint = 0;
+  }
+
+  // Written next to the final path, then renamed over it
+  char *temporary = malloc(strlen(path) + sizeof(".tmp"));
+  if (temporary == NULL)
+  {
+    return false;
+  }
+  sprintf(temporary, "%s.tmp", path);
+
+  // Shared mappings are not copied by the fork, committers preserving the pages it has not written yet
+  bool preserving = region->persistent || region->shared;
+
+  // Waiting for the turn of each domain, no epoch can commit while we hold them
+  for (size_t d = 0; d < MAX_DOMAINS; ++d)
+  {
+    TakeTurn(region, region->domains + d);
+  }
+
+  // Checkpoint of another process attached to the region, unless its writer is gone
+  bool started = true;
+  if (preserving && atomic_load(&(region->checkpointing)))
+  {
+    started = Exited(region->checkpoint_writer);
+  }
+
+  // Segments as of the boundary, committers changing the live ones from now on
+  Region *snapshot = region;
+  Segment *segments = Segments(region);
+  int fd = -1;
+  if (started && preserving)
+  {
+    size_t index = atomic_load(&(region->index));
+    snapshot = malloc(sizeof(Region) + index * sizeof(Segment));
+    fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    started = snapshot != NULL && fd >= 0 && realpath(temporary, region->checkpoint_path) != NULL;
+    if (started)
+    {
+      memcpy(snapshot, region, sizeof(Region));
+      segments = (Segment *)(snapshot + 1);
+      memcpy(segments, Segments(region), index * sizeof(Segment));
+      region->checkpoint_epoch = atomic_load(&(region->epoch));
+      region->checkpoint_id += 1;
+      atomic_store(&(region->checkpoint_failed), false);
+      atomic_store(&(region->checkpointing), true);
+    }
+  }
+
+  pid_t pid = started ? fork() : -1;
+  if (pid == 0)
+  {
+    // Region as of the last committed epoch
+    if (!preserving)
+    {
+      fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    bool written = fd >= 0 && WriteCheckpoint(region, snapshot, segments, fd) && !atomic_load(&(region->checkpoint_failed)) && close(fd) == 0 && rename(temporary, path) == 0;
+    if (preserving)
+    {
+      atomic_store(&(region->checkpointing), false);
+    }
+    _exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  if (pid > 0)
+  {
+    region->checkpoint = pid;
+    region->checkpoint_writer = pid;
+  }
+  else if (started)
+  {
+    atomic_store(&(region->checkpointing), false);
+  }
+
+  // Giving away turns
+  for (size_t d = 0; d < MAX_DOMAINS; ++d)
+  {
+    GiveTurn(region, region->domains + d);
+  }
+
+  // Committers of this process open the file again when they need it
+  if (fd >= 0)
+  {
+    close(fd);
+    if (pid < 0)
+    {
+      unlink(temporary);
+    }
+  }
+  if (snapshot != region)
+  {
+    free(snapshot);
+  }
+  free(temporary);
+  return pid > 0;
+}
+
+/** Start the change feed of the given shared memory region. From then on, each epoch that commits publishes one record per range of consecutive words it wrote, see tm_change_t, to a ring that any number of threads can read with tm_feed_read, and/or writes them to a file descriptor such as a pipe. Must be called with no running transaction, and only once.
+ * @param shared   Shared memory region to follow
+ * @param capacity Length of the ring (in bytes), 0 for no ring
+ * @param sink     File descriptor the records are written to, -1 for none
+ * @return Whether the feed was started, never for regions in shared memory
+ **/
+bool tm_feed_start(shared_t shared, size_t capacity, int sink)
+{
+  Region *region = (Region *)shared;
+  ChangeFeed *feed = &(region->feed);
+
+  // Ring is private to this process
+  if (region->shared || feed->ring != NULL || feed->sink >= 0)
+  {
+    return false;
+  }
+
+  if (capacity != 0)
+  {
+    feed->ring_capacity = RoundUp(capacity, 8);
+    feed->ring = malloc(feed->ring_capacity);
+    if (feed->ring == NULL)
+    {
+      return false;
+    }
+  }
+  feed->sink = sink;
+  return true;
+}
+
+/** [thread-safe] Copy the records of the change feed published since a cursor. Each reader keeps its own cursor, starting at 0.
+ * @param shared Shared memory region followed
+ * @param cursor Position of the first record to copy, moved past the copied records
+ * @param buffer Receives whole records, each a tm_change_t followed by its bytes
+ * @param length Length of the buffer (in bytes)
+ * @return Number of bytes copied, -1 when records since the cursor were overwritten before being read, the cursor then moving to the newest record
+ **/
+ssize_t tm_feed_read(shared_t shared, unsigned long long *cursor, void *buffer, size_t length)
+{
+  Region *region = (Region *)shared;
+  if (region->feed.ring == NULL)
+  {
+    return 0;
+  }
+  return FeedRead(&(region->feed), cursor, buffer, length);
+}
+
+/** [thread-safe] Return the current epoch of the given shared memory region. Committed state only changes when the epoch does.
+ * @param shared Shared memory region to query
+ * @return Number of epochs committed so far
+ **/
+unsigned long tm_epoch(shared_t shared) { return atomic_load(&(((Region *)shared)->epoch)); }
+
+/** [thread-safe] Return the last epoch that modified a range of the given shared memory region, with page granularity. A result computed from the range stays valid as long as this does not change.
+ * @param shared Shared memory region to query
+ * @param start  Start address of the range (in the shared region)
+ * @param size   Length of the range (in bytes)
+ * @return Last epoch that wrote to or allocated a page overlapping the range, the current epoch when the range is not within one segment
+ **/
+unsigned long tm_modified(shared_t shared, void const *start, size_t size)
+{
+  Region *region = (Region *)shared;
+
+  // Unknown ranges are assumed to have just changed
+  Segment *segment = LookupSegment(region, start);
+  if (segment == NULL || (char *)start + size > (char *)SegmentData(region, segment) + segment->size)
+  {
+    return tm_epoch(shared);
+  }
+
+  // Latest stamp of the pages overlapping the range
+  size_t offset = (char *)start - Data(region);
+  size_t last = (offset + (size == 0 ? 0 : size - 1)) / region->page_size;
+  unsigned long epoch = 0;
+  for (size_t page = offset / region->page_size; page <= last; ++page)
+  {
+    unsigned long stamp = atomic_load_explicit(Stamps(region) + page, memory_order_relaxed) & ~STAMP_BUSY;
+    epoch = stamp > epoch ? stamp : epoch;
+  }
+  return epoch;
+}
+
+/** [thread-safe] Abort the given transaction and sleep until an epoch commits a write to a range it read, in the spirit of 'retry'. The transaction is to be run again once this returns.
+ * @param shared Shared memory region associated with the transaction
+ * @param tx     Transaction to abort
+ * @param start  Start address of the range to watch (in the shared region), within one segment
+ * @param size   Length of the range (in bytes)
+ * @return Whether a write to the range was committed, 'false' when the range could not be watched, the transaction being aborted anyway
+ **/
+bool tm_wait_change(shared_t shared, tx_t tx, void const *start, size_t size)
+{
+  Region *region = (Region *)shared;
+
+  // Watching the range before leaving, so the commit of this epoch already sees it
+  Segment *segment = LookupSegment(region, start);
+  Waiter *waiter = NULL;
+  if (segment != NULL && (char *)start + size <= (char *)SegmentData(region, segment) + segment->size)
+  {
+    size_t offset = (char *)start - Data(region);
+    waiter = Watch(region, offset, offset + size);
+  }
+
+  // Aborting, which lets the epoch commit
+  Undo(region, tx);
+  if (waiter == NULL)
+  {
+    return false;
+  }
+
+  // Sleeping until a committer wakes us up
+  while (atomic_load(&(waiter->state)) == WAITER_WAITING)
+  {
+    FutexWait(&(waiter->state), WAITER_WAITING);
+  }
+
+  Unwatch(region, waiter);
+  return true;
+}
+
+/** Hand the epochs of the given shared memory region over to the process-wide coordinator, or take them back. The epochs of all the coordinated regions are committed in passes, each pass committing every epoch ready by then and waking the threads waiting on any of these regions with a single system call, threads waiting for long for an epoch or for the turn of a batcher being parked rather than spinning. The coordinator is the one of this library, regions of other libraries loaded in the process are not coordinated with these. Must be called with no running transaction.
+ * @param shared Shared memory region to coordinate
+ * @param enable Whether the region is coordinated from now on
+ * @return Whether the region is coordinated as requested, 'false' for regions in shared memory, whose other processes the coordinator cannot wake
+ **/
+bool tm_coordinate(shared_t shared, bool enable)
+{
+  Region *region = (Region *)shared;
+  if (enable && region->shared)
+  {
+    return false;
+  }
+
+  region->coordinated = enable;
+  return true;
+}
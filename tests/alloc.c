@@ -0,0 +1,55 @@
+/**
+ * @file   alloc.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_alloc running out of arena: an allocation larger than the
+ * arena reports nomem_alloc, leaving the transaction to go on and commit,
+ * and later allocations still find room.
+**/
+
+#include <stdint.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define OVERSIZED ((size_t)1 << 37)
+
+int main()
+{
+  shared_t region = tm_create(64, sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+
+  // Oversized allocation turned down, the transaction going on
+  tx_t tx = tm_begin(region, false);
+  CHECK(tx != invalid_tx);
+  void *segment;
+  CHECK(tm_alloc(region, tx, OVERSIZED, &segment) == nomem_alloc);
+  uint64_t value = 1;
+  CHECK(tm_write(region, tx, &value, sizeof(value), tm_start(region)));
+  CHECK(tm_end(region, tx));
+
+  // Room left for the allocations after it, even in the same transaction
+  for (size_t i = 0; i < 2; ++i)
+  {
+    tx = tm_begin(region, false);
+    CHECK(tx != invalid_tx);
+    CHECK(tm_alloc(region, tx, OVERSIZED, &segment) == nomem_alloc);
+    CHECK(tm_alloc(region, tx, 64, &segment) == success_alloc);
+    value = i + 2;
+    CHECK(tm_write(region, tx, &value, sizeof(value), segment));
+    CHECK(tm_end(region, tx));
+  }
+
+  // Words written are committed
+  tx = tm_begin(region, true);
+  CHECK(tm_read(region, tx, tm_start(region), sizeof(value), &value));
+  CHECK(value == 1);
+  CHECK(tm_read(region, tx, segment, sizeof(value), &value));
+  CHECK(value == 3);
+  CHECK(tm_end(region, tx));
+
+  tm_destroy(region);
+  return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file   api.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of the typed interface of 'tm_api.hpp', over the library of 'src/'
+ * and over an engine of 'tm_engine.hpp' compiled in.
+**/
+
+// External headers
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Internal headers
+#include <tm_api.hpp>
+#include <tm_engine.hpp>
+#include "test.h"
+
+// -------------------------------------------------------------------------- //
+
+using Engine = ::tm_engine::Engine<::tm_engine::Shadow, ::tm_engine::PerWord, ::tm_engine::TicketBatcher<16>, ::tm_engine::Yield>;
+
+/** Increment a counter from several threads, each increment in its own transaction.
+ * @param Backend Transaction manager backend
+**/
+template<class Backend> static void counter() {
+    constexpr size_t nbthreads = 4;
+    constexpr size_t nbincrements = 2000;
+    ::stm::basic_region<Backend, sizeof(uint64_t)> region{sizeof(uint64_t) * 2};
+    CHECK(region);
+    auto counter = region.template start<uint64_t>()[0];
+    ::std::vector<::std::thread> threads;
+    for (size_t i = 0; i < nbthreads; ++i) {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < nbincrements; ++j) {
+                auto done = ::stm::atomically(region, false, [&](auto& tx) {
+                    uint64_t value;
+                    return counter.load(tx, value) && counter.store(tx, value + 1);
+                });
+                CHECK(done);
+            }
+        });
+    }
+    for (auto& thread: threads)
+        thread.join();
+    uint64_t value = 0;
+    CHECK(::stm::atomically(region, true, [&](auto& tx) { return counter.load(tx, value); }));
+    CHECK(value == nbthreads * nbincrements);
+}
+
+/** Allocations larger than the arena fail without taking room from the later ones.
+ * @param Backend Transaction manager backend
+**/
+template<class Backend> static void oversized() {
+    constexpr size_t oversize = size_t{1} << 37;
+    ::stm::basic_region<Backend, sizeof(uint64_t)> region{sizeof(uint64_t)};
+    CHECK(region);
+    ::stm::span<uint64_t, Backend, sizeof(uint64_t)> segment;
+    for (uint64_t i = 0; i < 2; ++i) {
+        ::stm::basic_transaction<Backend, sizeof(uint64_t)> tx{region, false};
+        CHECK(tx);
+        CHECK(tx.alloc(oversize / sizeof(uint64_t), segment) == Alloc::nomem);
+        CHECK(tx);
+        CHECK(tx.alloc(1, segment) == Alloc::success);
+        CHECK(segment[0].store(tx, i + 1));
+        CHECK(tx.commit());
+    }
+    uint64_t value = 0;
+    CHECK(::stm::atomically(region, true, [&](auto& tx) { return segment[0].load(tx, value); }));
+    CHECK(value == 2);
+}
+
+/** Backend failing every read, counting the calls it receives.
+**/
+struct failing {
+    using handle = int*;
+    using tx = uintptr_t;
+    static constexpr handle invalid_handle = nullptr;
+    static constexpr tx invalid_tx = UINTPTR_MAX;
+    static inline size_t calls = 0;
+    static handle create(size_t, size_t) noexcept {
+        return new int{0};
+    }
+    static void destroy(handle region) noexcept {
+        delete region;
+    }
+    static void* start(handle region) noexcept {
+        return region;
+    }
+    static size_t size(handle) noexcept {
+        return sizeof(int);
+    }
+    static size_t align(handle) noexcept {
+        return sizeof(int);
+    }
+    static tx begin(handle, bool) noexcept {
+        ++calls;
+        return 0;
+    }
+    static bool end(handle, tx id) noexcept {
+        ++calls;
+        return id != invalid_tx;
+    }
+    static bool read(handle, tx, void const*, size_t, void*) noexcept {
+        ++calls;
+        return false;
+    }
+    static bool write(handle, tx id, void const*, size_t, void*) noexcept {
+        ++calls;
+        return id != invalid_tx;
+    }
+    static Alloc alloc(handle, tx id, size_t, void**) noexcept {
+        ++calls;
+        return id != invalid_tx ? Alloc::nomem : Alloc::abort;
+    }
+    static bool free(handle, tx id, void*) noexcept {
+        ++calls;
+        return id != invalid_tx;
+    }
+};
+
+/** Accesses and commit of an aborted transaction must not reach the backend.
+**/
+static void aborted() {
+    ::stm::basic_region<failing, sizeof(int)> region{sizeof(int)};
+    CHECK(region);
+    auto word = region.start<int>();
+    {
+        ::stm::basic_transaction<failing, sizeof(int)> tx{region, false};
+        CHECK(tx);
+        int value;
+        CHECK(!word[0].load(tx, value));
+        CHECK(!tx);
+        auto calls = failing::calls;
+        CHECK(!word[0].store(tx, 1));
+        ::stm::span<int, failing, sizeof(int)> segment;
+        CHECK(tx.alloc(1, segment) == Alloc::abort);
+        CHECK(!tx.free(word));
+        CHECK(!tx.commit());
+        CHECK(failing::calls == calls);
+    }
+}
+
+int main() {
+    counter<::stm::c_api>();
+    counter<::tm_engine::Direct<Engine>>();
+    oversized<::stm::c_api>();
+    oversized<::tm_engine::Direct<Engine>>();
+    aborted();
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file   batch.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_run_batch: threads running batches of increments over words
+ * they share, each increment reported as committed being in the words, and
+ * bodies giving up being reported as not committed.
+**/
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_THREADS 4
+#define NB_BATCHES 200
+#define NB_WORDS 8
+#define BATCH_SIZE 16
+
+static shared_t region;
+
+/** Increment the word given as context.
+ * @return Whether the body ran to completion
+**/
+static bool Increment(shared_t shared, tx_t tx, void *ctx)
+{
+  uint64_t value;
+  if (!tm_read(shared, tx, ctx, sizeof(value), &value))
+  {
+    return false;
+  }
+  ++value;
+  return tm_write(shared, tx, &value, sizeof(value), ctx);
+}
+
+/** Write to the word given as context, then give up.
+ * @return Never to completion
+**/
+static bool GiveUp(shared_t shared, tx_t tx, void *ctx)
+{
+  // Rolled back by tm_run_batch, whether the write went through or not
+  uint64_t value = UINT64_MAX;
+  (void)tm_write(shared, tx, &value, sizeof(value), ctx);
+  return false;
+}
+
+static void *Run(void *arg)
+{
+  uint64_t *words = tm_start(region);
+  size_t *committed = arg;
+  for (size_t i = 0; i < NB_BATCHES; ++i)
+  {
+    // Increments of the same words as the other threads, and one body giving up
+    tm_batch_fn callbacks[BATCH_SIZE + 1];
+    void *ctxs[BATCH_SIZE + 1];
+    bool results[BATCH_SIZE + 1];
+    for (size_t j = 0; j < BATCH_SIZE; ++j)
+    {
+      callbacks[j] = Increment;
+      ctxs[j] = words + (i + j) % NB_WORDS;
+    }
+    callbacks[BATCH_SIZE] = GiveUp;
+    ctxs[BATCH_SIZE] = words + NB_WORDS;
+
+    size_t n = tm_run_batch(region, BATCH_SIZE + 1, callbacks, ctxs, results);
+    CHECK(!results[BATCH_SIZE]);
+    size_t reported = 0;
+    for (size_t j = 0; j < BATCH_SIZE + 1; ++j)
+    {
+      reported += results[j];
+    }
+    CHECK(n == reported);
+    *committed += n;
+  }
+  return NULL;
+}
+
+int main()
+{
+  region = tm_create((NB_WORDS + 1) * sizeof(uint64_t), sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+
+  pthread_t threads[NB_THREADS];
+  size_t committed[NB_THREADS] = {0};
+  for (size_t i = 0; i < NB_THREADS; ++i)
+  {
+    CHECK(pthread_create(threads + i, NULL, Run, committed + i) == 0);
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < NB_THREADS; ++i)
+  {
+    CHECK(pthread_join(threads[i], NULL) == 0);
+    total += committed[i];
+  }
+
+  // Every increment reported is there, and only those
+  uint64_t words[NB_WORDS + 1];
+  tx_t tx = tm_begin(region, true);
+  CHECK(tm_read(region, tx, tm_start(region), sizeof(words), words));
+  CHECK(tm_end(region, tx));
+  uint64_t sum = 0;
+  for (size_t i = 0; i < NB_WORDS; ++i)
+  {
+    sum += words[i];
+  }
+  CHECK(sum == total);
+  CHECK(total != 0);
+  CHECK(words[NB_WORDS] == 0);
+
+  tm_destroy(region);
+  return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file   checkpoint.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_checkpoint: anonymous, file-backed and shared memory regions
+ * are checkpointed while threads keep committing transfers between their
+ * words, each checkpoint reopening with the words still summing to zero.
+**/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS (1 << 20)
+#define NB_THREADS 2
+#define NB_CHECKPOINTS 8
+
+static shared_t region;
+static atomic_bool running;
+
+/** Sum of the words of the first segment of a region, committed as one transaction.
+ * @param shared Region to sum
+ * @return Sum of the words
+**/
+static int64_t Sum(shared_t shared)
+{
+  static int64_t words[NB_WORDS];
+  tx_t tx = tm_begin(shared, true);
+  CHECK(tx != invalid_tx);
+  CHECK(tm_read(shared, tx, tm_start(shared), sizeof(words), words));
+  CHECK(tm_end(shared, tx));
+  int64_t sum = 0;
+  for (size_t i = 0; i < NB_WORDS; ++i)
+  {
+    sum += words[i];
+  }
+  return sum;
+}
+
+static void *Transfer(void *arg)
+{
+  unsigned int seed = (unsigned int)(uintptr_t)arg;
+  int64_t *words = tm_start(region);
+  while (atomic_load(&running))
+  {
+    // Moving one unit between two words, most often on different pages
+    int64_t *from = words + rand_r(&seed) % NB_WORDS;
+    int64_t *to = words + rand_r(&seed) % NB_WORDS;
+    tx_t tx = tm_begin(region, false);
+    CHECK(tx != invalid_tx);
+    int64_t value;
+    if (!tm_read(region, tx, from, sizeof(value), &value))
+    {
+      continue;
+    }
+    --value;
+    if (!tm_write(region, tx, &value, sizeof(value), from) || !tm_read(region, tx, to, sizeof(value), &value))
+    {
+      continue;
+    }
+    ++value;
+    if (!tm_write(region, tx, &value, sizeof(value), to))
+    {
+      continue;
+    }
+    tm_end(region, tx);
+  }
+  return NULL;
+}
+
+/** Checkpoint the region repeatedly while transfers commit, checking each checkpoint.
+ * @param path Path of the checkpoints
+**/
+static void Checkpoints(char const *path)
+{
+  char journal[128];
+  snprintf(journal, sizeof(journal), "%s-journal", path);
+
+  atomic_store(&running, true);
+  pthread_t threads[NB_THREADS];
+  for (size_t i = 0; i < NB_THREADS; ++i)
+  {
+    CHECK(pthread_create(threads + i, NULL, Transfer, (void *)(uintptr_t)(i + 1)) == 0);
+  }
+
+  for (size_t i = 0; i < NB_CHECKPOINTS; ++i)
+  {
+    // Previous checkpoint may still be reaped
+    unlink(path);
+    while (!tm_checkpoint(region, path))
+    {
+      usleep(1000);
+    }
+
+    // Complete once renamed to its path
+    while (access(path, F_OK) != 0)
+    {
+      usleep(1000);
+    }
+    shared_t copy = tm_create_file(path, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+    CHECK(copy != invalid_shared);
+    CHECK(Sum(copy) == 0);
+    tm_destroy(copy);
+    unlink(journal);
+  }
+
+  atomic_store(&running, false);
+  for (size_t i = 0; i < NB_THREADS; ++i)
+  {
+    CHECK(pthread_join(threads[i], NULL) == 0);
+  }
+  CHECK(Sum(region) == 0);
+  tm_destroy(region);
+  unlink(path);
+}
+
+int main()
+{
+  char path[64];
+  char name[128];
+  snprintf(path, sizeof(path), "/tmp/stm-checkpoint-%d", (int)getpid());
+
+  // Copied on write by the writer
+  region = tm_create(NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+  CHECK(region != invalid_shared);
+  Checkpoints(path);
+
+  // Shared with the writer, committers preserving pages
+  snprintf(name, sizeof(name), "%s-region", path);
+  char journal[sizeof(name) + sizeof("-journal")];
+  snprintf(journal, sizeof(journal), "%s-journal", name);
+  region = tm_create_file(name, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+  CHECK(region != invalid_shared);
+  Checkpoints(path);
+  unlink(name);
+  unlink(journal);
+
+  snprintf(name, sizeof(name), "/stm-checkpoint-%d", (int)getpid());
+  region = tm_create_shared(name, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+  CHECK(region != invalid_shared);
+  Checkpoints(path);
+  return 0;
+}
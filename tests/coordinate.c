@@ -0,0 +1,87 @@
+/**
+ * @file   coordinate.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_coordinate: threads incrementing counters in two coordinated
+ * regions, parked while waiting for epochs and turns, must see every
+ * increment committed.
+**/
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_THREADS 8
+#define NB_INCREMENTS 500
+
+static shared_t regions[2];
+
+static void *Increment(void *arg)
+{
+  (void)arg;
+  for (size_t i = 0; i < NB_INCREMENTS; ++i)
+  {
+    for (size_t r = 0; r < 2; ++r)
+    {
+      // Each transaction retried until it commits
+      while (true)
+      {
+        tx_t tx = tm_begin(regions[r], false);
+        CHECK(tx != invalid_tx);
+        uint64_t value;
+        if (!tm_read(regions[r], tx, tm_start(regions[r]), sizeof(value), &value))
+        {
+          continue;
+        }
+        ++value;
+        if (!tm_write(regions[r], tx, &value, sizeof(value), tm_start(regions[r])))
+        {
+          continue;
+        }
+        if (tm_end(regions[r], tx))
+        {
+          break;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
+int main()
+{
+  for (size_t r = 0; r < 2; ++r)
+  {
+    regions[r] = tm_create(sizeof(uint64_t), sizeof(uint64_t));
+    CHECK(regions[r] != invalid_shared);
+    CHECK(tm_coordinate(regions[r], true));
+  }
+
+  pthread_t threads[NB_THREADS];
+  for (size_t i = 0; i < NB_THREADS; ++i)
+  {
+    CHECK(pthread_create(threads + i, NULL, Increment, NULL) == 0);
+  }
+  for (size_t i = 0; i < NB_THREADS; ++i)
+  {
+    CHECK(pthread_join(threads[i], NULL) == 0);
+  }
+
+  for (size_t r = 0; r < 2; ++r)
+  {
+    tx_t tx = tm_begin(regions[r], true);
+    uint64_t value = 0;
+    CHECK(tm_read(regions[r], tx, tm_start(regions[r]), sizeof(value), &value));
+    CHECK(tm_end(regions[r], tx));
+    CHECK(value == NB_THREADS * NB_INCREMENTS);
+
+    // Taken back once no transaction runs
+    CHECK(tm_coordinate(regions[r], false));
+    tm_destroy(regions[r]);
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file   coro.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of the coroutine interface of 'tm_coro.hpp' over the library of 'src/':
+ * many coroutines incrementing one counter, driven by a few threads.
+**/
+
+// External headers
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Internal headers
+#include <tm_coro.hpp>
+#include "test.h"
+
+// -------------------------------------------------------------------------- //
+
+constexpr size_t nbcoroutines = 200;
+constexpr size_t nbincrements = 50;
+constexpr size_t nbthreads = 2;
+
+using region_t = ::stm::region<sizeof(uint64_t)>;
+
+/** Increment the counter the given number of times, one transaction each.
+ * @param region    Region holding the counter as first word
+ * @param queue     Executor running the coroutine
+ * @param committed Number of commits reported
+ * @param running   Coroutines still running, the queue being stopped by the last one
+**/
+static ::stm::task<void> increment(region_t const& region, ::stm::run_queue& queue, ::std::atomic<size_t>& committed, ::std::atomic<size_t>& running) {
+    auto counter = region.start<uint64_t>()[0];
+    for (size_t i = 0; i < nbincrements;) {
+        auto tx = co_await ::stm::begin(region, queue);
+        uint64_t value;
+        if (!counter.load(tx, value) || !counter.store(tx, value + 1))
+            continue;
+        if (co_await tx.commit()) {
+            committed.fetch_add(1);
+            ++i;
+        }
+    }
+    if (running.fetch_sub(1) == 1)
+        queue.stop();
+}
+
+int main() {
+    region_t region{sizeof(uint64_t)};
+    CHECK(region);
+    ::stm::run_queue queue;
+    ::std::atomic<size_t> committed{0};
+    ::std::atomic<size_t> running{nbcoroutines};
+    for (size_t i = 0; i < nbcoroutines; ++i)
+        ::stm::spawn(queue, increment(region, queue, committed, running));
+    ::std::vector<::std::thread> threads;
+    for (size_t i = 0; i < nbthreads; ++i)
+        threads.emplace_back([&]() { queue.run(); });
+    for (auto& thread: threads)
+        thread.join();
+    CHECK(committed.load() == nbcoroutines * nbincrements);
+    uint64_t value = 0;
+    CHECK(::stm::atomically(region, true, [&](auto& tx) { return region.start<uint64_t>()[0].load(tx, value); }));
+    CHECK(value == nbcoroutines * nbincrements);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file   declared.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_begin_declared: malformed write sets are refused, overlapping
+ * ones are pushed to the next epoch, and ones whose segment is freed while
+ * they wait fail to begin.
+**/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+static shared_t region;
+static void *segment;
+
+static void *Increment(void *arg)
+{
+  tm_range_t range = {tm_start(region), sizeof(uint64_t)};
+  tx_t tx = tm_begin_declared(region, &range, 1);
+  CHECK(tx != invalid_tx);
+
+  // Declared words cannot be taken by other transactions of the epoch
+  uint64_t value;
+  CHECK(tm_read(region, tx, range.start, sizeof(value), &value));
+  ++value;
+  CHECK(tm_write(region, tx, &value, sizeof(value), range.start));
+  CHECK(tm_end(region, tx));
+  return arg;
+}
+
+static void *Declare(void *arg)
+{
+  // Waits for the epoch freeing the segment, then finds it gone
+  tm_range_t range = {segment, sizeof(uint64_t)};
+  *(tx_t *)arg = tm_begin_declared(region, &range, 1);
+  return NULL;
+}
+
+int main()
+{
+  region = tm_create(sizeof(uint64_t) * 4, sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+
+  // Ranges outside of any segment, or not in whole words
+  tm_range_t outside = {(char *)tm_start(region) + 4 * sizeof(uint64_t), sizeof(uint64_t)};
+  tm_range_t partial = {tm_start(region), sizeof(uint64_t) / 2};
+  tm_range_t beyond = {tm_start(region), 5 * sizeof(uint64_t)};
+  CHECK(tm_begin_declared(region, &outside, 1) == invalid_tx);
+  CHECK(tm_begin_declared(region, &partial, 1) == invalid_tx);
+  CHECK(tm_begin_declared(region, &beyond, 1) == invalid_tx);
+
+  // Overlapping write sets, one per epoch
+  pthread_t threads[4];
+  for (size_t i = 0; i < 4; ++i)
+  {
+    CHECK(pthread_create(threads + i, NULL, Increment, NULL) == 0);
+  }
+  for (size_t i = 0; i < 4; ++i)
+  {
+    CHECK(pthread_join(threads[i], NULL) == 0);
+  }
+  tx_t tx = tm_begin(region, true);
+  uint64_t value = 0;
+  CHECK(tm_read(region, tx, tm_start(region), sizeof(value), &value));
+  CHECK(tm_end(region, tx));
+  CHECK(value == 4);
+
+  // Segment to free
+  tx = tm_begin(region, false);
+  CHECK(tm_alloc(region, tx, sizeof(uint64_t) * 4, &segment) == success_alloc);
+  CHECK(tm_end(region, tx));
+
+  // Written and freed in the epoch the declared transaction conflicts with
+  tx = tm_begin(region, false);
+  CHECK(tm_write(region, tx, &value, sizeof(value), segment));
+  CHECK(tm_free(region, tx, segment));
+  tx_t declared = 0;
+  pthread_t thread;
+  CHECK(pthread_create(&thread, NULL, Declare, &declared) == 0);
+  usleep(10000);
+  CHECK(tm_end(region, tx));
+  CHECK(pthread_join(thread, NULL) == 0);
+  CHECK(declared == invalid_tx);
+
+  // Region still usable afterwards
+  tm_range_t range = {tm_start(region), sizeof(uint64_t)};
+  tx = tm_begin_declared(region, &range, 1);
+  CHECK(tx != invalid_tx);
+  CHECK(tm_end(region, tx));
+
+  tm_destroy(region);
+  return 0;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file   domains.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_begin_domains: threads confined to the segment of their own
+ * domain commit transfers alongside transactions spanning both domains,
+ * which see the words of the two segments summing to zero, and transactions
+ * touching segments of other domains are aborted.
+**/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS 256
+#define NB_TRANSFERS 20000
+#define NB_SUMS 500
+
+static shared_t region;
+static int64_t *segments[2];
+
+/** Sum of the words of both segments, committed as one transaction of both domains.
+ * @return Sum of the words
+**/
+static int64_t Sum(void)
+{
+  int64_t words[2][NB_WORDS];
+  while (true)
+  {
+    tx_t tx = tm_begin_domains(region, true, 6);
+    CHECK(tx != invalid_tx);
+    if (tm_read(region, tx, segments[0], sizeof(words[0]), words[0]) && tm_read(region, tx, segments[1], sizeof(words[1]), words[1]) && tm_end(region, tx))
+    {
+      break;
+    }
+  }
+  int64_t sum = 0;
+  for (size_t i = 0; i < NB_WORDS; ++i)
+  {
+    sum += words[0][i] + words[1][i];
+  }
+  return sum;
+}
+
+/** Commit transfers between random words of the given segments.
+ * @param domains Set of domains of the transactions
+ * @param from    Segment of the words taken from
+ * @param to      Segment of the words given to
+ * @param seed    Seed of the words
+**/
+static void Transfer(unsigned int domains, int64_t *from, int64_t *to, unsigned int seed)
+{
+  for (size_t i = 0; i < NB_TRANSFERS;)
+  {
+    // Moving one unit between two words
+    int64_t *source = from + rand_r(&seed) % NB_WORDS;
+    int64_t *target = to + rand_r(&seed) % NB_WORDS;
+    tx_t tx = tm_begin_domains(region, false, domains);
+    CHECK(tx != invalid_tx);
+    int64_t value;
+    if (!tm_read(region, tx, source, sizeof(value), &value))
+    {
+      continue;
+    }
+    --value;
+    if (!tm_write(region, tx, &value, sizeof(value), source) || !tm_read(region, tx, target, sizeof(value), &value))
+    {
+      continue;
+    }
+    ++value;
+    if (!tm_write(region, tx, &value, sizeof(value), target))
+    {
+      continue;
+    }
+    if (tm_end(region, tx))
+    {
+      ++i;
+    }
+  }
+}
+
+/** Commit transfers within the segment of one domain. **/
+static void *Confined(void *arg)
+{
+  size_t index = (size_t)arg;
+  Transfer(2u << index, segments[index], segments[index], (unsigned int)index);
+  return NULL;
+}
+
+/** Commit transfers from one segment to the other, both ways. **/
+static void *Across(void *arg)
+{
+  (void)arg;
+  Transfer(6, segments[0], segments[1], 2);
+  Transfer(6, segments[1], segments[0], 3);
+  return NULL;
+}
+
+/** Check the sum of both segments while the others transfer. **/
+static void *Check(void *arg)
+{
+  (void)arg;
+  for (size_t i = 0; i < NB_SUMS; ++i)
+  {
+    CHECK(Sum() == 0);
+  }
+  return NULL;
+}
+
+int main()
+{
+  region = tm_create(NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+  CHECK(region != invalid_shared);
+
+  // Sets of domains out of range
+  CHECK(tm_begin_domains(region, false, 0) == invalid_tx);
+  CHECK(tm_begin_domains(region, false, 1u << 8) == invalid_tx);
+
+  // One segment in each of the second and third domains
+  for (size_t i = 0; i < 2; ++i)
+  {
+    tx_t tx = tm_begin_domains(region, false, 2u << i);
+    CHECK(tx != invalid_tx);
+    CHECK(tm_alloc(region, tx, NB_WORDS * sizeof(int64_t), (void **)(segments + i)) == success_alloc);
+    CHECK(tm_end(region, tx));
+  }
+
+  // Segments of other domains out of reach, including the first one
+  int64_t value;
+  tx_t tx = tm_begin(region, false);
+  CHECK(!tm_read(region, tx, segments[0], sizeof(value), &value));
+  tx = tm_begin_domains(region, true, 2);
+  CHECK(!tm_read(region, tx, tm_start(region), sizeof(value), &value));
+  tx = tm_begin_domains(region, false, 4);
+  value = 1;
+  CHECK(!tm_write(region, tx, &value, sizeof(value), segments[0]));
+
+  pthread_t threads[5];
+  CHECK(pthread_create(threads + 0, NULL, Confined, (void *)0) == 0);
+  CHECK(pthread_create(threads + 1, NULL, Confined, (void *)1) == 0);
+  CHECK(pthread_create(threads + 2, NULL, Confined, (void *)1) == 0);
+  CHECK(pthread_create(threads + 3, NULL, Across, NULL) == 0);
+  CHECK(pthread_create(threads + 4, NULL, Check, NULL) == 0);
+  for (size_t i = 0; i < 5; ++i)
+  {
+    CHECK(pthread_join(threads[i], NULL) == 0);
+  }
+  CHECK(Sum() == 0);
+
+  tm_destroy(region);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file   durable.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_create_durable: epochs committed by a process that exits
+ * without its region's file being synced are replayed from the redo log
+ * on reopen, up to the last whole record when the log is torn.
+**/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS 1024
+#define NB_EPOCHS 64
+
+static char path[64];
+static char log_path[sizeof(path) + sizeof("-log")];
+static char before_path[sizeof(path) + sizeof("-before")];
+static char saved_path[sizeof(path) + sizeof("-saved")];
+
+/** Copy a whole file, leaving its holes out.
+ * @param from Path of the file to copy
+ * @param to   Path of the copy, replaced
+**/
+static void Copy(char const *from, char const *to)
+{
+  int source = open(from, O_RDONLY);
+  int target = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK(source >= 0 && target >= 0);
+  off_t end = lseek(source, 0, SEEK_END);
+  CHECK(ftruncate(target, end) == 0);
+  for (off_t data = lseek(source, 0, SEEK_DATA); data >= 0 && data < end; data = lseek(source, data, SEEK_DATA))
+  {
+    // Whole range of data up to the next hole
+    off_t hole = lseek(source, data, SEEK_HOLE);
+    char buffer[1 << 16];
+    while (data < hole)
+    {
+      ssize_t length = pread(source, buffer, hole - data < (off_t)sizeof(buffer) ? hole - data : (off_t)sizeof(buffer), data);
+      CHECK(length > 0 && pwrite(target, buffer, length, data) == length);
+      data += length;
+    }
+  }
+  close(source);
+  close(target);
+}
+
+/** Open the region, checking which of the words written by the epochs are there.
+ * @param epochs Number of epochs expected to be replayed
+**/
+static void Check(size_t epochs)
+{
+  shared_t region = tm_create_durable(path, log_path, NB_WORDS * sizeof(uint64_t), sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+  uint64_t words[NB_WORDS];
+  tx_t tx = tm_begin(region, true);
+  CHECK(tm_read(region, tx, tm_start(region), sizeof(words), words));
+  CHECK(tm_end(region, tx));
+  for (size_t i = 0; i < NB_EPOCHS; ++i)
+  {
+    // Words spread over several pages
+    size_t word = (i * 67) % NB_WORDS;
+    CHECK(words[word] == (i < epochs ? i + 1 : 0));
+  }
+  tm_destroy(region);
+}
+
+int main()
+{
+  snprintf(path, sizeof(path), "/tmp/stm-durable-%d", (int)getpid());
+  snprintf(log_path, sizeof(log_path), "%s-log", path);
+  snprintf(before_path, sizeof(before_path), "%s-before", path);
+  snprintf(saved_path, sizeof(saved_path), "%s-saved", path);
+  unlink(path);
+  unlink(log_path);
+
+  // File as it is before the epochs, standing for their writes not having reached it
+  shared_t region = tm_create_durable(path, log_path, NB_WORDS * sizeof(uint64_t), sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+  tm_destroy(region);
+  Copy(path, before_path);
+
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0)
+  {
+    // One epoch per transaction, the process exiting without closing the region
+    region = tm_create_durable(path, log_path, NB_WORDS * sizeof(uint64_t), sizeof(uint64_t));
+    CHECK(region != invalid_shared);
+    for (size_t i = 0; i < NB_EPOCHS; ++i)
+    {
+      uint64_t value = i + 1;
+      tx_t tx = tm_begin(region, false);
+      CHECK(tm_write(region, tx, &value, sizeof(value), (uint64_t *)tm_start(region) + (i * 67) % NB_WORDS));
+      CHECK(tm_end(region, tx));
+    }
+    _exit(EXIT_SUCCESS);
+  }
+  int status;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+  Copy(log_path, saved_path);
+
+  // Every epoch replayed from the log
+  Copy(before_path, path);
+  Check(NB_EPOCHS);
+
+  // Torn record at the end of the log is dropped, along with its epoch only
+  struct stat log;
+  CHECK(stat(saved_path, &log) == 0);
+  Copy(before_path, path);
+  Copy(saved_path, log_path);
+  CHECK(truncate(log_path, log.st_size - 1) == 0);
+  Check(NB_EPOCHS - 1);
+
+  unlink(path);
+  unlink(log_path);
+  unlink(before_path);
+  unlink(saved_path);
+  return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file   feed.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of the change feed: the words written by each epoch are published
+ * as one record per range of consecutive words, both to the ring read with
+ * tm_feed_read and to a pipe, and readers left behind by the ring are told.
+**/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS 64
+#define RING_CAPACITY 4096
+
+/** Commit one transaction writing its own index to some words.
+ * @param region Region to write
+ * @param words  Indexes of the words to write
+ * @param n      Number of words
+**/
+static void Write(shared_t region, size_t const *words, size_t n)
+{
+  uint64_t *start = tm_start(region);
+  tx_t tx = tm_begin(region, false);
+  CHECK(tx != invalid_tx);
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint64_t value = words[i];
+    CHECK(tm_write(region, tx, &value, sizeof(value), start + words[i]));
+  }
+  CHECK(tm_end(region, tx));
+}
+
+/** Check one record of the feed.
+ * @param record Record, header followed by its bytes
+ * @param region Region written
+ * @param first  Index of the first word of the record
+ * @param n      Number of words of the record
+ * @return Length of the record
+**/
+static size_t Check(char const *record, shared_t region, size_t first, size_t n)
+{
+  tm_change_t change;
+  memcpy(&change, record, sizeof(change));
+  CHECK(change.epoch == tm_epoch(region));
+  CHECK(change.segment == tm_start(region));
+  CHECK(change.offset == first * sizeof(uint64_t));
+  CHECK(change.size == n * sizeof(uint64_t));
+  for (size_t i = 0; i < n; ++i)
+  {
+    uint64_t value;
+    memcpy(&value, record + sizeof(change) + i * sizeof(value), sizeof(value));
+    CHECK(value == first + i);
+  }
+  return sizeof(change) + change.size;
+}
+
+int main()
+{
+  shared_t region = tm_create(NB_WORDS * sizeof(uint64_t), sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+  int sink[2];
+  CHECK(pipe(sink) == 0);
+  CHECK(tm_feed_start(region, RING_CAPACITY, sink[1]));
+  CHECK(!tm_feed_start(region, RING_CAPACITY, -1));
+
+  // Consecutive words share one record, in the order of the words
+  size_t words[] = {10, 3, 2, 4};
+  Write(region, words, sizeof(words) / sizeof(words[0]));
+  char ring[RING_CAPACITY];
+  unsigned long long cursor = 0;
+  ssize_t length = tm_feed_read(region, &cursor, ring, sizeof(ring));
+  CHECK(length > 0);
+  size_t offset = Check(ring, region, 2, 3);
+  offset += Check(ring + offset, region, 10, 1);
+  CHECK(offset == (size_t)length);
+
+  // Same records written to the sink
+  char piped[RING_CAPACITY];
+  CHECK(read(sink[0], piped, sizeof(piped)) == length);
+  CHECK(memcmp(piped, ring, length) == 0);
+
+  // Read-only transactions publish nothing
+  tx_t tx = tm_begin(region, true);
+  uint64_t value;
+  CHECK(tm_read(region, tx, tm_start(region), sizeof(value), &value));
+  CHECK(tm_end(region, tx));
+  CHECK(tm_feed_read(region, &cursor, ring, sizeof(ring)) == 0);
+
+  // Reader left behind by more than the ring, moved to the newest record
+  size_t all[NB_WORDS];
+  for (size_t i = 0; i < NB_WORDS; ++i)
+  {
+    all[i] = i;
+  }
+  for (size_t i = 0; i < 4 * RING_CAPACITY / (NB_WORDS * sizeof(uint64_t)); ++i)
+  {
+    Write(region, all, NB_WORDS / 4);
+    CHECK(read(sink[0], piped, sizeof(piped)) > 0);
+  }
+  CHECK(tm_feed_read(region, &cursor, ring, sizeof(ring)) == -1);
+  CHECK(tm_feed_read(region, &cursor, ring, sizeof(ring)) == 0);
+  Write(region, all, 1);
+  length = tm_feed_read(region, &cursor, ring, sizeof(ring));
+  CHECK(length > 0 && Check(ring, region, 0, 1) == (size_t)length);
+
+  tm_destroy(region);
+  close(sink[0]);
+  close(sink[1]);
+  return 0;
+}
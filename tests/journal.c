@@ -0,0 +1,123 @@
+/**
+ * @file   journal.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of the journal of tm_create_file: processes killed at random while
+ * committing transfers between the words of a file region, which must reopen
+ * with the words still summing to zero.
+**/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS 512
+#define NB_THREADS 2
+#define NB_KILLS 20
+
+static char path[64];
+static shared_t region;
+
+/** Sum of the words of the first segment, committed as one transaction.
+ * @return Sum of the words
+**/
+static int64_t Sum(void)
+{
+  int64_t words[NB_WORDS];
+  tx_t tx = tm_begin(region, true);
+  CHECK(tx != invalid_tx);
+  CHECK(tm_read(region, tx, tm_start(region), sizeof(words), words));
+  CHECK(tm_end(region, tx));
+  int64_t sum = 0;
+  for (size_t i = 0; i < NB_WORDS; ++i)
+  {
+    sum += words[i];
+  }
+  return sum;
+}
+
+static void *Transfer(void *arg)
+{
+  unsigned int seed = (unsigned int)(uintptr_t)arg;
+  int64_t *words = tm_start(region);
+  while (true)
+  {
+    // Moving one unit between two words, spread over many pages per epoch
+    int64_t *from = words + rand_r(&seed) % NB_WORDS;
+    int64_t *to = words + rand_r(&seed) % NB_WORDS;
+    tx_t tx = tm_begin(region, false);
+    CHECK(tx != invalid_tx);
+    int64_t value;
+    if (!tm_read(region, tx, from, sizeof(value), &value))
+    {
+      continue;
+    }
+    --value;
+    if (!tm_write(region, tx, &value, sizeof(value), from) || !tm_read(region, tx, to, sizeof(value), &value))
+    {
+      continue;
+    }
+    ++value;
+    if (!tm_write(region, tx, &value, sizeof(value), to))
+    {
+      continue;
+    }
+    tm_end(region, tx);
+  }
+  return NULL;
+}
+
+int main()
+{
+  snprintf(path, sizeof(path), "/tmp/stm-journal-%d", (int)getpid());
+  char journal[sizeof(path) + sizeof("-journal")];
+  snprintf(journal, sizeof(journal), "%s-journal", path);
+  unlink(path);
+  unlink(journal);
+
+  srand((unsigned int)getpid());
+  for (size_t round = 0; round < NB_KILLS; ++round)
+  {
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0)
+    {
+      // Reopening the file left by the process killed before
+      region = tm_create_file(path, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+      CHECK(region != invalid_shared);
+      CHECK(Sum() == 0);
+      pthread_t threads[NB_THREADS];
+      for (size_t i = 0; i < NB_THREADS; ++i)
+      {
+        CHECK(pthread_create(threads + i, NULL, Transfer, (void *)(uintptr_t)(getpid() + i)) == 0);
+      }
+      CHECK(pthread_join(threads[0], NULL) == 0);
+      return EXIT_FAILURE;
+    }
+
+    // Killed while it commits
+    usleep(20000 + rand() % 20000);
+    CHECK(kill(pid, SIGKILL) == 0);
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFSIGNALED(status));
+  }
+
+  region = tm_create_file(path, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+  CHECK(region != invalid_shared);
+  CHECK(Sum() == 0);
+  tm_destroy(region);
+  unlink(path);
+  unlink(journal);
+  return 0;
+}
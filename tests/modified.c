@@ -0,0 +1,77 @@
+/**
+ * @file   modified.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_epoch and tm_modified: epochs move with the commits of writes
+ * only, and each page remembers the last epoch that wrote or allocated it.
+**/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+/** Commit one transaction writing one word.
+ * @param region Region to write
+ * @param target Word to write
+**/
+static void Write(shared_t region, uint64_t *target)
+{
+  uint64_t value = 1;
+  tx_t tx = tm_begin(region, false);
+  CHECK(tx != invalid_tx);
+  CHECK(tm_write(region, tx, &value, sizeof(value), target));
+  CHECK(tm_end(region, tx));
+}
+
+int main()
+{
+  size_t page = getpagesize();
+  shared_t region = tm_create(3 * page, sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+  char *start = tm_start(region);
+
+  // Epoch of a write, seen on its page only
+  unsigned long before = tm_epoch(region);
+  Write(region, (uint64_t *)(start + page));
+  unsigned long written = tm_epoch(region);
+  CHECK(written == before + 1);
+  CHECK(tm_modified(region, start + page, page) == written);
+  CHECK(tm_modified(region, start + page + page / 2, sizeof(uint64_t)) == written);
+  CHECK(tm_modified(region, start, page) < written);
+  CHECK(tm_modified(region, start + 2 * page, page) < written);
+
+  // Ranges over several pages take the latest of them
+  CHECK(tm_modified(region, start, 2 * page) == written);
+  CHECK(tm_modified(region, start, 3 * page) == written);
+
+  // Read-only transactions commit no epoch
+  tx_t tx = tm_begin(region, true);
+  uint64_t value;
+  CHECK(tm_read(region, tx, start, sizeof(value), &value));
+  CHECK(tm_end(region, tx));
+  CHECK(tm_epoch(region) == written);
+
+  // Later writes elsewhere leave the page alone
+  Write(region, (uint64_t *)start);
+  CHECK(tm_epoch(region) == written + 1);
+  CHECK(tm_modified(region, start, page) == written + 1);
+  CHECK(tm_modified(region, start + page, page) == written);
+
+  // Segments allocated are stamped with the epoch committing them
+  void *segment;
+  tx = tm_begin(region, false);
+  CHECK(tm_alloc(region, tx, page, &segment) == success_alloc);
+  CHECK(tm_end(region, tx));
+  CHECK(tm_modified(region, segment, page) == tm_epoch(region));
+
+  // Ranges beyond a segment are assumed to have just changed
+  CHECK(tm_modified(region, start + 2 * page, 2 * page) == tm_epoch(region));
+
+  tm_destroy(region);
+  return 0;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file   reap.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_create_shared: processes killed at random while committing
+ * transfers between the words of a region in shared memory, wherever they
+ * are in the batcher, the process left keeping on committing with the words
+ * still summing to zero.
+**/
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS 512
+#define NB_CHILDREN 4
+#define NB_KILLS 40
+
+static char name[64];
+static shared_t region;
+
+/** Sum of the words of the first segment, committed as one transaction.
+ * @return Sum of the words
+**/
+static int64_t Sum(void)
+{
+  int64_t words[NB_WORDS];
+  while (true)
+  {
+    tx_t tx = tm_begin(region, true);
+    CHECK(tx != invalid_tx);
+    if (tm_read(region, tx, tm_start(region), sizeof(words), words) && tm_end(region, tx))
+    {
+      break;
+    }
+  }
+  int64_t sum = 0;
+  for (size_t i = 0; i < NB_WORDS; ++i)
+  {
+    sum += words[i];
+  }
+  return sum;
+}
+
+/** Commit transfers between random words.
+ * @param seed Seed of the words
+ * @param n    Number of transfers to commit, 0 to go on forever
+**/
+static void Transfer(unsigned int seed, size_t n)
+{
+  int64_t *words = tm_start(region);
+  for (size_t i = 0; n == 0 || i < n;)
+  {
+    // Moving one unit between two words
+    int64_t *from = words + rand_r(&seed) % NB_WORDS;
+    int64_t *to = words + rand_r(&seed) % NB_WORDS;
+    tx_t tx = tm_begin(region, false);
+    CHECK(tx != invalid_tx);
+    int64_t value;
+    if (!tm_read(region, tx, from, sizeof(value), &value))
+    {
+      continue;
+    }
+    --value;
+    if (!tm_write(region, tx, &value, sizeof(value), from) || !tm_read(region, tx, to, sizeof(value), &value))
+    {
+      continue;
+    }
+    ++value;
+    if (!tm_write(region, tx, &value, sizeof(value), to))
+    {
+      continue;
+    }
+    if (tm_end(region, tx))
+    {
+      ++i;
+    }
+  }
+}
+
+/** Attach to the region and commit transfers until killed.
+ * @return Process running the transfers
+**/
+static pid_t Spawn(void)
+{
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0)
+  {
+    region = tm_create_shared(name, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+    CHECK(region != invalid_shared);
+    Transfer((unsigned int)getpid(), 0);
+  }
+  return pid;
+}
+
+int main()
+{
+  snprintf(name, sizeof(name), "/stm-reap-%d", (int)getpid());
+  shm_unlink(name);
+  region = tm_create_shared(name, NB_WORDS * sizeof(int64_t), sizeof(int64_t));
+  CHECK(region != invalid_shared);
+
+  // Failing rather than hanging should a dead process hold the others back
+  alarm(120);
+
+  pid_t children[NB_CHILDREN];
+  for (size_t i = 0; i < NB_CHILDREN; ++i)
+  {
+    children[i] = Spawn();
+  }
+
+  srand((unsigned int)getpid());
+  for (size_t round = 0; round < NB_KILLS; ++round)
+  {
+    // Committing alongside the children, then killing one of them wherever it is
+    Transfer((unsigned int)round, 50);
+    usleep(rand() % 10000);
+    size_t victim = rand() % NB_CHILDREN;
+    CHECK(kill(children[victim], SIGKILL) == 0);
+    int status;
+    CHECK(waitpid(children[victim], &status, 0) == children[victim]);
+    CHECK(WIFSIGNALED(status));
+    children[victim] = Spawn();
+  }
+
+  for (size_t i = 0; i < NB_CHILDREN; ++i)
+  {
+    CHECK(kill(children[i], SIGKILL) == 0);
+    CHECK(waitpid(children[i], NULL, 0) == children[i]);
+  }
+
+  // Transactions of the dead are rolled back, the epochs they held going on
+  Transfer(0, 1000);
+  CHECK(Sum() == 0);
+  tm_destroy(region);
+  shm_unlink(name);
+  return 0;
+}
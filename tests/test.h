@@ -0,0 +1,23 @@
+/**
+ * @file   test.h
+ *
+ * @section DESCRIPTION
+ *
+ * Checks shared by the behaviour tests, in C and C++.
+**/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Stop the test with a failure status if the given condition does not hold.
+ * @param condition Condition to check
+**/
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
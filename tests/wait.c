@@ -0,0 +1,102 @@
+/**
+ * @file   wait.c
+ *
+ * @section DESCRIPTION
+ *
+ * Tests of tm_wait_change: two threads taking turns, each waiting for the
+ * word of the other one to reach its turn, are woken by the commits writing
+ * it however close to their reads these are, and ranges outside of the
+ * segments cannot be waited for.
+**/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <tm.h>
+#include <tm_ext.h>
+#include "test.h"
+
+#define NB_WORDS 64
+#define NB_TURNS 1000
+
+static shared_t region;
+
+/** Wait for a word to reach a value, then write another word.
+ * @param watched Word waited for
+ * @param target  Value waited for
+ * @param written Word written once the value is reached
+ * @param value   Value written
+**/
+static void Turn(uint64_t *watched, uint64_t target, uint64_t *written, uint64_t value)
+{
+  while (true)
+  {
+    tx_t tx = tm_begin(region, false);
+    CHECK(tx != invalid_tx);
+    uint64_t current;
+    if (!tm_read(region, tx, watched, sizeof(current), &current))
+    {
+      continue;
+    }
+    if (current != target)
+    {
+      // Sleeping until the word is written, reading it again then
+      CHECK(current + 1 == target);
+      CHECK(tm_wait_change(region, tx, watched, sizeof(current)));
+      continue;
+    }
+    if (tm_write(region, tx, &value, sizeof(value), written) && tm_end(region, tx))
+    {
+      return;
+    }
+  }
+}
+
+/** Take the turns of the second thread, on the other end of the segment. **/
+static void *Answer(void *arg)
+{
+  (void)arg;
+  uint64_t *words = tm_start(region);
+  for (uint64_t turn = 1; turn <= NB_TURNS; ++turn)
+  {
+    Turn(words, turn, words + NB_WORDS - 1, turn);
+  }
+  return NULL;
+}
+
+int main()
+{
+  region = tm_create(NB_WORDS * sizeof(uint64_t), sizeof(uint64_t));
+  CHECK(region != invalid_shared);
+  uint64_t *words = tm_start(region);
+
+  // Ranges outside of the segments, the transaction aborted anyway
+  tx_t tx = tm_begin(region, true);
+  CHECK(tx != invalid_tx);
+  CHECK(!tm_wait_change(region, tx, words + NB_WORDS, sizeof(uint64_t)));
+  tx = tm_begin(region, true);
+  CHECK(tx != invalid_tx);
+  CHECK(!tm_wait_change(region, tx, words + NB_WORDS - 1, 2 * sizeof(uint64_t)));
+
+  // Failing rather than hanging should a commit not wake the thread waiting
+  alarm(60);
+
+  pthread_t other;
+  CHECK(pthread_create(&other, NULL, Answer, NULL) == 0);
+  for (uint64_t turn = 1; turn <= NB_TURNS; ++turn)
+  {
+    Turn(words + NB_WORDS - 1, turn - 1, words, turn);
+  }
+  CHECK(pthread_join(other, NULL) == 0);
+
+  tx = tm_begin(region, true);
+  uint64_t value;
+  CHECK(tm_read(region, tx, words + NB_WORDS - 1, sizeof(value), &value));
+  CHECK(tm_end(region, tx));
+  CHECK(value == NB_TURNS);
+
+  tm_destroy(region);
+  return 0;
+}
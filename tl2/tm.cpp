@@ -0,0 +1,18 @@
+/**
+ * @file   tm.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Transaction manager in the style of TL2, built from 'tm_engine.hpp': each
+ * word has a versioned write lock, a global version clock dates transactions,
+ * reads are invisible and validated against it, and writes are buffered then
+ * written back under the locks on commit. There is no batcher; freed segments
+ * are reused once every transaction older than their free has left.
+**/
+
+// Internal headers
+#include <tm_engine.hpp>
+
+// -------------------------------------------------------------------------- //
+
+TM_ENGINE_EXPORT(::tm_engine::Engine<::tm_engine::RedoLog, ::tm_engine::InvisibleReads, ::tm_engine::ScalableBatcher, ::tm_engine::Yield>)